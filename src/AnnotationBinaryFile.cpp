@@ -0,0 +1,233 @@
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include "AnnotationBinaryFile.hpp"
+#include "AnnotationFileWriter.hpp"
+
+namespace sonarlog_annotation {
+
+namespace annotation_binary_file {
+
+namespace {
+
+uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+void pad(std::ofstream& out, uint64_t offset) {
+    static const char zeros[8] = { 0 };
+    out.write(zeros, align(offset) - offset);
+}
+
+// the section is aligned and its count entries end inside the file, without overflow
+bool sectionFits(uint64_t offset, uint64_t count, uint64_t entry_size, uint64_t size) {
+    return offset == align(offset) && offset <= size && count <= (size - offset) / entry_size;
+}
+
+} /* namespace */
+
+bool isBinaryFile(const std::string& filepath) {
+    std::ifstream in(filepath.c_str(), std::ios::in | std::ios::binary);
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    return in.good() && memcmp(magic, kMagic, sizeof(magic)) == 0;
+}
+
+void write(const std::string& filepath, const std::vector<AnnotationFileReader::AnnotationMap>& annotations) {
+    std::vector<LabelEntry> labels;
+    std::vector<SampleEntry> samples(annotations.size());
+    std::vector<PolygonEntry> polygons;
+    std::vector<cv::Point2f> points;
+    std::string strings;
+    std::map<std::string, uint32_t> label_ids;
+
+    for (size_t sample_index = 0; sample_index < annotations.size(); sample_index++) {
+        samples[sample_index].first_polygon = polygons.size();
+        samples[sample_index].polygon_count = annotations[sample_index].size();
+
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations[sample_index].begin(); it != annotations[sample_index].end(); it++) {
+            std::map<std::string, uint32_t>::iterator label_it = label_ids.find(it->first);
+            if (label_it == label_ids.end()) {
+                LabelEntry label;
+                label.offset = strings.size();
+                label.length = it->first.size();
+                strings += it->first;
+                label_it = label_ids.insert(std::make_pair(it->first, (uint32_t)labels.size())).first;
+                labels.push_back(label);
+            }
+
+            PolygonEntry polygon;
+            polygon.label_id = label_it->second;
+            polygon.first_point = points.size();
+            polygon.point_count = it->second.size();
+            polygon.reserved = 0;
+            polygons.push_back(polygon);
+            points.insert(points.end(), it->second.begin(), it->second.end());
+        }
+    }
+
+    Header header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sample_count = samples.size();
+    header.label_count = labels.size();
+    header.polygon_count = polygons.size();
+    header.point_count = points.size();
+    header.labels_offset = align(sizeof(Header));
+    header.samples_offset = align(header.labels_offset + labels.size() * sizeof(LabelEntry));
+    header.polygons_offset = align(header.samples_offset + samples.size() * sizeof(SampleEntry));
+    header.points_offset = align(header.polygons_offset + polygons.size() * sizeof(PolygonEntry));
+    header.strings_offset = align(header.points_offset + points.size() * sizeof(cv::Point2f));
+    header.strings_size = strings.size();
+
+    std::ofstream out(filepath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot open the annotation file: " + filepath);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    pad(out, sizeof(Header));
+
+    if (!labels.empty()) out.write(reinterpret_cast<const char*>(&labels[0]), labels.size() * sizeof(LabelEntry));
+    pad(out, header.labels_offset + labels.size() * sizeof(LabelEntry));
+
+    if (!samples.empty()) out.write(reinterpret_cast<const char*>(&samples[0]), samples.size() * sizeof(SampleEntry));
+    pad(out, header.samples_offset + samples.size() * sizeof(SampleEntry));
+
+    if (!polygons.empty()) out.write(reinterpret_cast<const char*>(&polygons[0]), polygons.size() * sizeof(PolygonEntry));
+    pad(out, header.polygons_offset + polygons.size() * sizeof(PolygonEntry));
+
+    if (!points.empty()) out.write(reinterpret_cast<const char*>(&points[0]), points.size() * sizeof(cv::Point2f));
+    pad(out, header.points_offset + points.size() * sizeof(cv::Point2f));
+
+    out.write(strings.data(), strings.size());
+    out.close();
+
+    if (out.fail()) {
+        throw std::runtime_error("cannot write the annotation file: " + filepath);
+    }
+}
+
+void convertYamlToBinary(const std::string& yaml_filepath, const std::string& binary_filepath) {
+    AnnotationFileReader reader(yaml_filepath);
+    write(binary_filepath, reader.read());
+}
+
+void convertBinaryToYaml(const std::string& binary_filepath, const std::string& yaml_filepath) {
+    AnnotationBinaryReader reader(binary_filepath);
+    AnnotationFileWriter writer(yaml_filepath);
+    writer.write(reader.read());
+}
+
+} /* namespace annotation_binary_file */
+
+AnnotationBinaryReader::AnnotationBinaryReader(const std::string& filepath)
+    : file_(filepath)
+{
+    using namespace annotation_binary_file;
+
+    const char* data = file_.data();
+    uint64_t size = file_.size();
+
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("invalid binary annotation file: " + filepath);
+    }
+
+    header_ = reinterpret_cast<const Header*>(data);
+
+    if (memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 ||
+        header_->version != kVersion ||
+        !sectionFits(header_->labels_offset, header_->label_count, sizeof(LabelEntry), size) ||
+        !sectionFits(header_->samples_offset, header_->sample_count, sizeof(SampleEntry), size) ||
+        !sectionFits(header_->polygons_offset, header_->polygon_count, sizeof(PolygonEntry), size) ||
+        !sectionFits(header_->points_offset, header_->point_count, sizeof(cv::Point2f), size) ||
+        header_->strings_offset > size ||
+        header_->strings_size > size - header_->strings_offset) {
+        throw std::runtime_error("invalid binary annotation file: " + filepath);
+    }
+
+    labels_ = reinterpret_cast<const LabelEntry*>(data + header_->labels_offset);
+    samples_ = reinterpret_cast<const SampleEntry*>(data + header_->samples_offset);
+    polygons_ = reinterpret_cast<const PolygonEntry*>(data + header_->polygons_offset);
+    points_ = reinterpret_cast<const cv::Point2f*>(data + header_->points_offset);
+    strings_ = data + header_->strings_offset;
+
+    // the entries are checked once here, the views handed out afterwards
+    // always point inside the mapping
+    for (uint32_t i = 0; i < header_->label_count; i++) {
+        if (uint64_t(labels_[i].offset) + labels_[i].length > header_->strings_size) {
+            throw std::runtime_error("invalid label entry in the binary annotation file: " + filepath);
+        }
+    }
+
+    for (uint32_t i = 0; i < header_->sample_count; i++) {
+        if (uint64_t(samples_[i].first_polygon) + samples_[i].polygon_count > header_->polygon_count) {
+            throw std::runtime_error("invalid sample entry in the binary annotation file: " + filepath);
+        }
+    }
+
+    for (uint32_t i = 0; i < header_->polygon_count; i++) {
+        if (polygons_[i].label_id >= header_->label_count ||
+            uint64_t(polygons_[i].first_point) + polygons_[i].point_count > header_->point_count) {
+            throw std::runtime_error("invalid polygon entry in the binary annotation file: " + filepath);
+        }
+    }
+}
+
+AnnotationBinaryReader::PolygonView AnnotationBinaryReader::polygon(size_t sample_index, size_t polygon_index) const {
+    const annotation_binary_file::PolygonEntry& entry = polygons_[samples_[sample_index].first_polygon + polygon_index];
+
+    PolygonView view;
+    view.label_id = entry.label_id;
+    view.points = points_ + entry.first_point;
+    view.size = entry.point_count;
+    return view;
+}
+
+std::string AnnotationBinaryReader::label(uint32_t label_id) const {
+    return std::string(strings_ + labels_[label_id].offset, labels_[label_id].length);
+}
+
+int AnnotationBinaryReader::findLabel(const std::string& name) const {
+    for (uint32_t label_id = 0; label_id < header_->label_count; label_id++) {
+        if (labels_[label_id].length == name.size() &&
+            memcmp(strings_ + labels_[label_id].offset, name.data(), name.size()) == 0) {
+            return label_id;
+        }
+    }
+    return -1;
+}
+
+void AnnotationBinaryReader::readSample(size_t sample_index, AnnotationFileReader::AnnotationMap& annotations) const {
+    for (size_t i = 0; i < polygonCount(sample_index); i++) {
+        PolygonView view = polygon(sample_index, i);
+        annotations[label(view.label_id)].assign(view.points, view.points + view.size);
+    }
+}
+
+std::vector<AnnotationFileReader::AnnotationMap> AnnotationBinaryReader::read() const {
+    std::vector<AnnotationFileReader::AnnotationMap> annotations(sampleCount());
+    for (size_t sample_index = 0; sample_index < sampleCount(); sample_index++) {
+        readSample(sample_index, annotations[sample_index]);
+    }
+    return annotations;
+}
+
+void AnnotationBinaryReader::read(AnnotationStore& annotations) const {
+    std::vector<std::string> labels(labelCount());
+    for (size_t label_id = 0; label_id < labels.size(); label_id++) {
+        labels[label_id] = label(label_id);
+    }
+
+    annotations.resize(sampleCount());
+    for (size_t sample_index = 0; sample_index < sampleCount(); sample_index++) {
+        for (size_t i = 0; i < polygonCount(sample_index); i++) {
+            PolygonView view = polygon(sample_index, i);
+            annotations.set(sample_index, labels[view.label_id], view.points, view.size);
+        }
+    }
+}
+
+} /* namespace sonarlog_annotation */
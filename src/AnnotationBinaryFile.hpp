@@ -0,0 +1,134 @@
+#ifndef sonarlog_annotation_AnnotationBinaryFile_hpp
+#define sonarlog_annotation_AnnotationBinaryFile_hpp
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "AnnotationFileReader.hpp"
+#include "AnnotationStore.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Binary annotation file layout (little endian):
+ *
+ *   header      magic "SLAB", version, counts and section offsets
+ *   labels      label_count x { string offset, string length }
+ *   samples     sample_count x { first polygon, polygon count }
+ *   polygons    polygon_count x { label id, first point, point count, reserved }
+ *   points      point_count x { float x, float y }
+ *   strings     label names, not null terminated
+ *
+ * Label names are interned, each polygon refers to its label by id and
+ * the points of all polygons are stored in one contiguous array.
+ */
+namespace annotation_binary_file {
+
+const char kMagic[4] = { 'S', 'L', 'A', 'B' };
+const uint32_t kVersion = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t sample_count;
+    uint32_t label_count;
+    uint32_t polygon_count;
+    uint32_t point_count;
+    uint64_t labels_offset;
+    uint64_t samples_offset;
+    uint64_t polygons_offset;
+    uint64_t points_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct LabelEntry {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SampleEntry {
+    uint32_t first_polygon;
+    uint32_t polygon_count;
+};
+
+struct PolygonEntry {
+    uint32_t label_id;
+    uint32_t first_point;
+    uint32_t point_count;
+    uint32_t reserved;
+};
+
+bool isBinaryFile(const std::string& filepath);
+
+void write(const std::string& filepath, const std::vector<AnnotationFileReader::AnnotationMap>& annotations);
+
+// convert between the YAML and the binary annotation files
+void convertYamlToBinary(const std::string& yaml_filepath, const std::string& binary_filepath);
+void convertBinaryToYaml(const std::string& binary_filepath, const std::string& yaml_filepath);
+
+} /* namespace annotation_binary_file */
+
+/*
+ * Zero-copy reader of the binary annotation file.
+ *
+ * The file is memory mapped, the polygon views point straight into the
+ * mapping and stay valid while the reader is open. Every entry is checked
+ * when the file is opened, a truncated or corrupt file throws
+ * std::runtime_error.
+ */
+class AnnotationBinaryReader {
+public:
+
+    struct PolygonView {
+        uint32_t label_id;
+        const cv::Point2f* points;
+        size_t size;
+    };
+
+    AnnotationBinaryReader(const std::string& filepath);
+
+    virtual ~AnnotationBinaryReader() {
+    }
+
+    size_t sampleCount() const {
+        return header_->sample_count;
+    }
+
+    size_t labelCount() const {
+        return header_->label_count;
+    }
+
+    size_t polygonCount(size_t sample_index) const {
+        return samples_[sample_index].polygon_count;
+    }
+
+    PolygonView polygon(size_t sample_index, size_t polygon_index) const;
+
+    std::string label(uint32_t label_id) const;
+
+    // returns the label id or -1 if the label is not in the file
+    int findLabel(const std::string& name) const;
+
+    void readSample(size_t sample_index, AnnotationFileReader::AnnotationMap& annotations) const;
+
+    std::vector<AnnotationFileReader::AnnotationMap> read() const;
+
+    // copy the annotations into the store, which is not cleared first
+    void read(AnnotationStore& annotations) const;
+
+private:
+
+    boost::iostreams::mapped_file_source file_;
+    const annotation_binary_file::Header* header_;
+    const annotation_binary_file::LabelEntry* labels_;
+    const annotation_binary_file::SampleEntry* samples_;
+    const annotation_binary_file::PolygonEntry* polygons_;
+    const cv::Point2f* points_;
+    const char* strings_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationBinaryFile_hpp */
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <exception>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include "AnnotationDataset.hpp"
+
+namespace sonarlog_annotation {
+
+void AnnotationDataset::load(const std::vector<std::string>& filepaths, size_t thread_count) {
+    clear();
+
+    files_.resize(filepaths.size());
+    for (size_t i = 0; i < filepaths.size(); i++) {
+        files_[i].filepath = filepaths[i];
+        files_[i].loaded = false;
+        files_[i].first_sample = 0;
+        files_[i].sample_count = 0;
+    }
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, boost::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, filepaths.size());
+
+    std::vector<Job> jobs(filepaths.size());
+    next_job_ = 0;
+    next_merge_ = 0;
+
+    boost::thread_group threads;
+    for (size_t i = 0; i < thread_count; i++) {
+        threads.create_thread(boost::bind(&AnnotationDataset::worker, this, &jobs));
+    }
+    threads.join_all();
+
+    // a file finished while another thread was merging is merged here
+    mergeReadyJobs(jobs);
+}
+
+void AnnotationDataset::loadDirectory(const std::string& directory, size_t thread_count) {
+    load(findAnnotationFiles(directory), thread_count);
+}
+
+void AnnotationDataset::clear() {
+    files_.clear();
+    samples_.clear();
+    polygons_.clear();
+    points_.clear();
+    labels_.clear();
+    label_ids_.clear();
+}
+
+size_t AnnotationDataset::failedFileCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < files_.size(); i++) {
+        if (!files_[i].loaded) count++;
+    }
+    return count;
+}
+
+std::vector<std::string> AnnotationDataset::findAnnotationFiles(const std::string& directory) {
+    const std::string suffix = "_annotation.yml";
+    std::vector<std::string> filepaths;
+
+    boost::system::error_code error;
+    boost::filesystem::recursive_directory_iterator it(directory, error), end;
+
+    for (; !error && it != end; it.increment(error)) {
+        std::string filename = it->path().filename().string();
+        if (boost::filesystem::is_regular_file(it->status()) &&
+            filename.size() >= suffix.size() &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            filepaths.push_back(it->path().string());
+        }
+    }
+
+    std::sort(filepaths.begin(), filepaths.end());
+    return filepaths;
+}
+
+void AnnotationDataset::worker(std::vector<Job>* jobs) {
+    while (true) {
+        size_t file_index;
+        {
+            boost::mutex::scoped_lock lock(job_mutex_);
+            if (next_job_ >= jobs->size()) {
+                break;
+            }
+            file_index = next_job_++;
+        }
+
+        Job job;
+        try {
+            const std::string& filepath = files_[file_index].filepath;
+            if (!boost::filesystem::is_regular_file(filepath)) {
+                job.error = "annotation file not found: " + filepath;
+            }
+            else {
+                AnnotationFileReader reader(filepath);
+                job.annotations = reader.read();
+                if (!reader.opened()) {
+                    job.error = "cannot read the annotation file: " + filepath;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            job.error = e.what();
+        }
+
+        {
+            boost::mutex::scoped_lock lock(job_mutex_);
+            (*jobs)[file_index].annotations.swap(job.annotations);
+            (*jobs)[file_index].error = job.error;
+            (*jobs)[file_index].done = true;
+        }
+
+        mergeReadyJobs(*jobs);
+    }
+}
+
+void AnnotationDataset::mergeReadyJobs(std::vector<Job>& jobs) {
+    // only one thread merges at a time, the files are merged in their order
+    boost::mutex::scoped_lock merge_lock(merge_mutex_, boost::try_to_lock);
+    if (!merge_lock.owns_lock()) {
+        return;
+    }
+
+    while (true) {
+        Job* job = NULL;
+        size_t file_index;
+        {
+            boost::mutex::scoped_lock lock(job_mutex_);
+            if (next_merge_ < jobs.size() && jobs[next_merge_].done) {
+                file_index = next_merge_++;
+                job = &jobs[file_index];
+            }
+        }
+
+        if (!job) {
+            break;
+        }
+
+        merge(file_index, *job);
+    }
+}
+
+void AnnotationDataset::merge(size_t file_index, Job& job) {
+    File& file = files_[file_index];
+    file.first_sample = samples_.size();
+
+    if (!job.error.empty()) {
+        file.error = job.error;
+        return;
+    }
+
+    for (size_t sample_index = 0; sample_index < job.annotations.size(); sample_index++) {
+        const AnnotationFileReader::AnnotationMap& annotations = job.annotations[sample_index];
+        if (annotations.empty()) {
+            continue;
+        }
+
+        Sample sample;
+        sample.file_index = file_index;
+        sample.sample_index = sample_index;
+        sample.first_polygon = polygons_.size();
+        sample.polygon_count = annotations.size();
+        samples_.push_back(sample);
+
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations.begin(); it != annotations.end(); it++) {
+            Polygon polygon;
+            polygon.label_id = labelId(it->first);
+            polygon.first_point = points_.size();
+            polygon.point_count = it->second.size();
+            polygons_.push_back(polygon);
+            points_.insert(points_.end(), it->second.begin(), it->second.end());
+        }
+    }
+
+    file.sample_count = samples_.size() - file.first_sample;
+    file.loaded = true;
+
+    std::vector<AnnotationFileReader::AnnotationMap>().swap(job.annotations);
+}
+
+uint32_t AnnotationDataset::labelId(const std::string& label) {
+    std::map<std::string, uint32_t>::iterator it = label_ids_.find(label);
+    if (it != label_ids_.end()) {
+        return it->second;
+    }
+
+    uint32_t label_id = labels_.size();
+    labels_.push_back(label);
+    label_ids_.insert(std::make_pair(label, label_id));
+    return label_id;
+}
+
+} /* namespace sonarlog_annotation */
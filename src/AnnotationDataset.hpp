@@ -0,0 +1,121 @@
+#ifndef sonarlog_annotation_AnnotationDataset_hpp
+#define sonarlog_annotation_AnnotationDataset_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include "AnnotationFileReader.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Annotations of many annotation files loaded into one compact structure.
+ *
+ * The files are parsed concurrently and merged in the order they were
+ * given, so the result does not depend on the number of threads. Only the
+ * annotated samples are kept: labels are interned and the points of all
+ * polygons are stored in one contiguous array. A file that fails to load
+ * is reported in its file entry and does not abort the others.
+ */
+class AnnotationDataset {
+public:
+
+    struct File {
+        std::string filepath;
+        bool loaded;
+        std::string error;
+        uint32_t first_sample;
+        uint32_t sample_count;
+    };
+
+    struct Sample {
+        uint32_t file_index;
+        uint32_t sample_index;
+        uint32_t first_polygon;
+        uint32_t polygon_count;
+    };
+
+    struct Polygon {
+        uint32_t label_id;
+        uint32_t first_point;
+        uint32_t point_count;
+    };
+
+    AnnotationDataset() {
+    }
+
+    virtual ~AnnotationDataset() {
+    }
+
+    // thread_count 0 uses one thread per core
+    void load(const std::vector<std::string>& filepaths, size_t thread_count = 0);
+
+    void loadDirectory(const std::string& directory, size_t thread_count = 0);
+
+    void clear();
+
+    const std::vector<File>& files() const {
+        return files_;
+    }
+
+    const std::vector<Sample>& samples() const {
+        return samples_;
+    }
+
+    const std::vector<Polygon>& polygons() const {
+        return polygons_;
+    }
+
+    const std::vector<cv::Point2f>& points() const {
+        return points_;
+    }
+
+    const std::vector<std::string>& labels() const {
+        return labels_;
+    }
+
+    const cv::Point2f* polygonPoints(const Polygon& polygon) const {
+        return &points_[polygon.first_point];
+    }
+
+    size_t failedFileCount() const;
+
+    // the annotation files (*_annotation.yml) below the directory, sorted by path
+    static std::vector<std::string> findAnnotationFiles(const std::string& directory);
+
+private:
+
+    struct Job {
+        Job()
+            : done(false)
+        {
+        }
+
+        bool done;
+        std::string error;
+        std::vector<AnnotationFileReader::AnnotationMap> annotations;
+    };
+
+    void worker(std::vector<Job>* jobs);
+    void mergeReadyJobs(std::vector<Job>& jobs);
+    void merge(size_t file_index, Job& job);
+    uint32_t labelId(const std::string& label);
+
+    std::vector<File> files_;
+    std::vector<Sample> samples_;
+    std::vector<Polygon> polygons_;
+    std::vector<cv::Point2f> points_;
+    std::vector<std::string> labels_;
+    std::map<std::string, uint32_t> label_ids_;
+
+    boost::mutex job_mutex_;
+    boost::mutex merge_mutex_;
+    size_t next_job_;
+    size_t next_merge_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationDataset_hpp */
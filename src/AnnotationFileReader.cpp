@@ -1,27 +1,84 @@
 #include <stdio.h>
+#include <cstdlib>
+#include <sstream>
 #include <sonar_processing/ImageUtil.hpp>
+#include "AnnotationBinaryFile.hpp"
 #include "AnnotationFileReader.hpp"
+#include "AnnotationJournal.hpp"
+#include "AnnotationStore.hpp"
+#include "Profiler.hpp"
 
 namespace sonarlog_annotation {
 
 std::vector<AnnotationFileReader::AnnotationMap> AnnotationFileReader::read() {
-    cv::FileStorage file_storage(filepath_, cv::FileStorage::READ);
+    ScopedTimer timer("annotation.read");
+    std::vector<AnnotationMap> samples_annotations;
 
-    cv::FileNode node = file_storage.root();
-    cv::FileNodeIterator it = node.begin();
+    cv::FileStorage file_storage;
+    opened_ = false;
+    if (annotation_binary_file::isBinaryFile(filepath_)) {
+        samples_annotations = AnnotationBinaryReader(filepath_).read();
+        opened_ = true;
+    }
+    else if (file_storage.open(filepath_, cv::FileStorage::READ)) {
+        opened_ = true;
+        cv::FileNode node = file_storage.root();
+        cv::FileNodeIterator it = node.begin();
 
-    std::vector<AnnotationMap> samples_annotations;
+        // only the annotated samples are stored, each node is named after its sample
+        while (it != node.end()) {
+            int sample_index = sampleIndexOf((*it).name());
+            if (sample_index == -1) {
+                sample_index = samples_annotations.size();
+            }
 
-    while (it != node.end()) {
-        AnnotationMap annotation_map;
-        readAnnotation(*it, annotation_map);
-        samples_annotations.push_back(annotation_map);
-        it++;
+            if (sample_index >= (int)samples_annotations.size()) {
+                samples_annotations.resize(sample_index + 1);
+            }
+
+            readAnnotation(*it, samples_annotations[sample_index]);
+            it++;
+        }
     }
 
+    AnnotationJournal::replay(AnnotationJournal::journalFilePath(filepath_), samples_annotations);
+
     return samples_annotations;
 }
 
+void AnnotationFileReader::read(AnnotationStore& annotations) {
+    ScopedTimer timer("annotation.read");
+    annotations.clear();
+
+    cv::FileStorage file_storage;
+    opened_ = false;
+    if (annotation_binary_file::isBinaryFile(filepath_)) {
+        AnnotationBinaryReader(filepath_).read(annotations);
+        opened_ = true;
+    }
+    else if (file_storage.open(filepath_, cv::FileStorage::READ)) {
+        opened_ = true;
+        cv::FileNode node = file_storage.root();
+        cv::FileNodeIterator it = node.begin();
+
+        while (it != node.end()) {
+            int sample_index = sampleIndexOf((*it).name());
+            if (sample_index == -1) {
+                sample_index = annotations.sampleCount();
+            }
+
+            if (sample_index >= (int)annotations.sampleCount()) {
+                annotations.resize(sample_index + 1);
+            }
+
+            readAnnotation(*it, sample_index, annotations);
+            it++;
+        }
+    }
+
+    AnnotationJournal::replay(AnnotationJournal::journalFilePath(filepath_), annotations);
+}
+
 void AnnotationFileReader::readAnnotation(cv::FileNode node, AnnotationFileReader::AnnotationMap& annotations) {
     cv::FileNodeIterator it = node.begin();
     cv::Mat mat;
@@ -34,4 +91,39 @@ void AnnotationFileReader::readAnnotation(cv::FileNode node, AnnotationFileReade
     }
 }
 
+void AnnotationFileReader::readAnnotation(cv::FileNode node, size_t sample_index, AnnotationStore& annotations) {
+    cv::FileNodeIterator it = node.begin();
+    cv::Mat mat;
+
+    while (it != node.end()) {
+        (*it) >> mat;
+
+        // the point matrices are copied straight into the store
+        if (mat.type() == CV_32FC2 && mat.isContinuous()) {
+            annotations.set(sample_index, (*it).name(), mat.ptr<cv::Point2f>(), mat.total());
+        }
+        else {
+            annotations.set(sample_index, (*it).name(), sonar_processing::image_util::mat2vector<cv::Point2f>(mat));
+        }
+        it++;
+    }
+}
+
+int AnnotationFileReader::sampleIndexOf(const std::string& sample_name) {
+    const std::string prefix = "sample_";
+    if (sample_name.compare(0, prefix.size(), prefix) != 0 || sample_name.size() == prefix.size()) {
+        return -1;
+    }
+
+    char* end = NULL;
+    long sample_index = strtol(sample_name.c_str() + prefix.size(), &end, 10);
+    return (end && *end == '\0' && sample_index >= 0) ? (int)sample_index : -1;
+}
+
+std::string AnnotationFileReader::sampleName(size_t sample_index) {
+    std::stringstream name;
+    name << "sample_" << sample_index;
+    return name.str();
+}
+
 } /* sonarlog_annotation */
@@ -8,6 +8,7 @@
 
 namespace sonarlog_annotation {
 
+class AnnotationStore;
 
 class AnnotationFileReader {
 public:
@@ -16,20 +17,39 @@ public:
 
     AnnotationFileReader(const std::string& filepath) 
         : filepath_(filepath)
+        , opened_(false)
     {
     }
 
     virtual ~AnnotationFileReader() {
     }
     
+    // read the annotation file (YAML or binary) and replay its journal, if there is one
     std::vector<AnnotationFileReader::AnnotationMap> read();
 
-private:
+    // read straight into the annotation store, its previous content is discarded
+    void read(AnnotationStore& annotations);
 
-    void readAnnotation(cv::FileNode node, AnnotationFileReader::AnnotationMap& annotations);
+    // whether the last read opened the annotation file, a missing or
+    // unreadable file reads as no annotations (plus its journal, if any)
+    bool opened() const {
+        return opened_;
+    }
 
-    std::string filepath_;
+    // read the annotations of one sample node
+    static void readAnnotation(cv::FileNode node, AnnotationFileReader::AnnotationMap& annotations);
+
+    static void readAnnotation(cv::FileNode node, size_t sample_index, AnnotationStore& annotations);
+
+    // sample index of a "sample_<index>" node name, -1 for any other name
+    static int sampleIndexOf(const std::string& sample_name);
 
+    static std::string sampleName(size_t sample_index);
+
+private:
+
+    std::string filepath_;
+    bool opened_;
 };
 
 } /* namespace sonarlog_annotation */
@@ -0,0 +1,27 @@
+#include "AnnotationFileWriter.hpp"
+#include "Profiler.hpp"
+
+namespace sonarlog_annotation {
+
+void AnnotationFileWriter::write(const std::vector<AnnotationFileReader::AnnotationMap>& annotations) {
+    ScopedTimer timer("annotation.write");
+    cv::FileStorage file_storage(filepath_, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_YAML);
+
+    // the samples without annotations are left out of the file
+    for (size_t sample_number = 0; sample_number < annotations.size(); sample_number++) {
+        if (annotations[sample_number].empty()) {
+            continue;
+        }
+
+        file_storage << AnnotationFileReader::sampleName(sample_number);
+        file_storage << "{";
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations[sample_number].begin(); it != annotations[sample_number].end(); it++) {
+            file_storage << it->first << cv::Mat(it->second);
+        }
+        file_storage << "}";
+    }
+    file_storage.release();
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,34 @@
+#ifndef sonarlog_annotation_AnnotationFileWriter_hpp
+#define sonarlog_annotation_AnnotationFileWriter_hpp
+
+#include <string>
+#include <vector>
+#include "AnnotationFileReader.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Writes annotations in the YAML layout read by AnnotationFileReader.
+ * Only the annotated samples are written.
+ */
+class AnnotationFileWriter {
+public:
+
+    AnnotationFileWriter(const std::string& filepath)
+        : filepath_(filepath)
+    {
+    }
+
+    virtual ~AnnotationFileWriter() {
+    }
+
+    void write(const std::vector<AnnotationFileReader::AnnotationMap>& annotations);
+
+private:
+
+    std::string filepath_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationFileWriter_hpp */
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include "AnnotationIndexedReader.hpp"
+#include "AnnotationJournal.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r\"'");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t\r\"'");
+    return s.substr(begin, end - begin + 1);
+}
+
+} /* namespace */
+
+AnnotationIndexedReader::AnnotationIndexedReader(const std::string& filepath)
+    : filepath_(filepath)
+    , sample_count_(0)
+{
+    if (annotation_binary_file::isBinaryFile(filepath_)) {
+        binary_reader_.reset(new AnnotationBinaryReader(filepath_));
+        sample_count_ = binary_reader_->sampleCount();
+    }
+    else {
+        buildYamlIndex();
+    }
+
+    applyJournal();
+}
+
+int AnnotationIndexedReader::findSample(const std::string& sample_name) const {
+    std::map<std::string, size_t>::const_iterator it = names_.find(sample_name);
+    if (it != names_.end()) {
+        return it->second;
+    }
+
+    // the samples without annotations are not in the index
+    int sample_index = AnnotationFileReader::sampleIndexOf(sample_name);
+    return (sample_index != -1 && (size_t)sample_index < sample_count_) ? sample_index : -1;
+}
+
+AnnotationIndexedReader::AnnotationMap AnnotationIndexedReader::readSample(size_t sample_index) {
+    std::map<size_t, AnnotationMap>::const_iterator it = journal_samples_.find(sample_index);
+    if (it != journal_samples_.end()) {
+        return it->second;
+    }
+
+    AnnotationMap annotations;
+    parseSample(sample_index, annotations);
+    return annotations;
+}
+
+AnnotationIndexedReader::AnnotationMap AnnotationIndexedReader::readSample(const std::string& sample_name) {
+    int sample_index = findSample(sample_name);
+    return (sample_index == -1) ? AnnotationMap() : readSample(sample_index);
+}
+
+std::vector<AnnotationIndexedReader::AnnotationMap> AnnotationIndexedReader::readRange(size_t begin, size_t end) {
+    end = std::min(end, sample_count_);
+
+    std::vector<AnnotationMap> annotations;
+    for (size_t sample_index = begin; sample_index < end; sample_index++) {
+        annotations.push_back(readSample(sample_index));
+    }
+    return annotations;
+}
+
+std::vector<AnnotationIndexedReader::LabeledPolygon> AnnotationIndexedReader::readLabel(const std::string& label, size_t begin, size_t end) {
+    end = std::min(end, sample_count_);
+
+    int binary_label_id = (binary_reader_) ? binary_reader_->findLabel(label) : -1;
+
+    std::vector<LabeledPolygon> polygons;
+    for (size_t sample_index = begin; sample_index < end; sample_index++) {
+        if (journal_samples_.count(sample_index)) {
+            const AnnotationMap& annotations = journal_samples_[sample_index];
+            AnnotationMap::const_iterator it = annotations.find(label);
+            if (it != annotations.end()) {
+                polygons.push_back(LabeledPolygon(sample_index, it->second));
+            }
+        }
+        else if (binary_reader_) {
+            if (binary_label_id == -1) continue;
+
+            for (size_t i = 0; i < binary_reader_->polygonCount(sample_index); i++) {
+                AnnotationBinaryReader::PolygonView view = binary_reader_->polygon(sample_index, i);
+                if (view.label_id == (uint32_t)binary_label_id) {
+                    polygons.push_back(LabeledPolygon(sample_index, std::vector<cv::Point2f>(view.points, view.points + view.size)));
+                }
+            }
+        }
+        else if (sample_index < entries_.size() && entries_[sample_index].labels.count(label)) {
+            AnnotationMap annotations;
+            parseSample(sample_index, annotations);
+            AnnotationMap::const_iterator it = annotations.find(label);
+            if (it != annotations.end()) {
+                polygons.push_back(LabeledPolygon(sample_index, it->second));
+            }
+        }
+    }
+
+    return polygons;
+}
+
+void AnnotationIndexedReader::visit(Visitor& visitor) {
+    for (size_t sample_index = 0; sample_index < sample_count_; sample_index++) {
+        visitor.visit(sample_index, readSample(sample_index));
+    }
+}
+
+void AnnotationIndexedReader::buildYamlIndex() {
+    in_.open(filepath_.c_str(), std::ios::in | std::ios::binary);
+    if (!in_.is_open()) {
+        return;
+    }
+
+    std::string line;
+    uint64_t offset = 0;
+    int label_indent = -1;
+    int current = -1;
+
+    while (std::getline(in_, line)) {
+        uint64_t line_offset = offset;
+        offset += line.size() + 1;
+
+        if (line.empty() || line[0] == '%' || line[0] == '#' || line.compare(0, 3, "---") == 0) {
+            continue;
+        }
+
+        if (line[0] != ' ') {
+            // top level key: a new sample starts here
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+
+            if (current != -1) {
+                entries_[current].length = line_offset - entries_[current].offset;
+            }
+
+            // the entries are placed by the sample index of their name, the
+            // samples left out of the file keep an empty entry
+            std::string name = trim(line.substr(0, colon));
+            current = AnnotationFileReader::sampleIndexOf(name);
+            if (current == -1) {
+                current = entries_.size();
+            }
+
+            if (current >= (int)entries_.size()) {
+                entries_.resize(current + 1);
+            }
+
+            Entry& entry = entries_[current];
+            entry.name = name;
+            entry.offset = line_offset;
+            entry.length = 0;
+            names_.insert(std::make_pair(entry.name, (size_t)current));
+            label_indent = -1;
+        }
+        else if (current != -1) {
+            // the keys of the first indentation level are the labels
+            size_t indent = line.find_first_not_of(' ');
+            if (indent == std::string::npos || line[indent] == '-') {
+                continue;
+            }
+
+            if (label_indent == -1) {
+                label_indent = indent;
+            }
+
+            size_t colon = line.find(':', indent);
+            if ((int)indent == label_indent && colon != std::string::npos) {
+                entries_[current].labels.insert(trim(line.substr(indent, colon - indent)));
+            }
+        }
+    }
+
+    in_.clear();
+    in_.seekg(0, std::ios::end);
+    uint64_t file_size = in_.tellg();
+
+    if (current != -1) {
+        entries_[current].length = file_size - entries_[current].offset;
+    }
+
+    sample_count_ = entries_.size();
+}
+
+void AnnotationIndexedReader::applyJournal() {
+    std::string journal_filepath = AnnotationJournal::journalFilePath(filepath_);
+
+    std::set<int> touched_samples;
+    AnnotationJournal::touchedSamples(journal_filepath, touched_samples);
+    if (touched_samples.empty()) {
+        return;
+    }
+
+    std::vector<AnnotationMap> annotations(sample_count_);
+    std::set<int>::const_iterator it;
+    for (it = touched_samples.begin(); it != touched_samples.end(); it++) {
+        if ((size_t)*it < sample_count_) {
+            parseSample(*it, annotations[*it]);
+        }
+    }
+
+    AnnotationJournal::replay(journal_filepath, annotations);
+
+    for (it = touched_samples.begin(); it != touched_samples.end(); it++) {
+        if ((size_t)*it < annotations.size()) {
+            journal_samples_[*it] = annotations[*it];
+        }
+    }
+
+    // samples appended by the journal are empty unless they were touched
+    for (size_t sample_index = sample_count_; sample_index < annotations.size(); sample_index++) {
+        if (!journal_samples_.count(sample_index)) {
+            journal_samples_[sample_index] = AnnotationMap();
+        }
+    }
+
+    sample_count_ = annotations.size();
+}
+
+void AnnotationIndexedReader::parseSample(size_t sample_index, AnnotationMap& annotations) {
+    if (binary_reader_) {
+        if (sample_index < binary_reader_->sampleCount()) {
+            binary_reader_->readSample(sample_index, annotations);
+        }
+        return;
+    }
+
+    if (sample_index >= entries_.size()) {
+        return;
+    }
+
+    const Entry& entry = entries_[sample_index];
+    if (entry.length == 0) {
+        return;
+    }
+
+    std::string content(entry.length, '\0');
+    in_.clear();
+    in_.seekg(entry.offset);
+    in_.read(&content[0], entry.length);
+
+    cv::FileStorage file_storage("%YAML:1.0\n" + content, cv::FileStorage::READ | cv::FileStorage::MEMORY);
+    cv::FileNode root = file_storage.root();
+
+    if (root.begin() != root.end()) {
+        AnnotationFileReader::readAnnotation(*root.begin(), annotations);
+    }
+}
+
+} /* namespace sonarlog_annotation */
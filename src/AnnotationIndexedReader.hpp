@@ -0,0 +1,97 @@
+#ifndef sonarlog_annotation_AnnotationIndexedReader_hpp
+#define sonarlog_annotation_AnnotationIndexedReader_hpp
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <boost/scoped_ptr.hpp>
+#include "AnnotationBinaryFile.hpp"
+#include "AnnotationFileReader.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Random access reader of an annotation file.
+ *
+ * Opening the reader scans the file once and records where each sample
+ * and which labels it holds, without parsing the point matrices. Samples
+ * are then parsed only when they are requested. The journal of the file
+ * is applied to the samples it changes.
+ *
+ * The reader is not thread safe.
+ */
+class AnnotationIndexedReader {
+public:
+
+    typedef AnnotationFileReader::AnnotationMap AnnotationMap;
+    typedef std::pair<size_t, std::vector<cv::Point2f> > LabeledPolygon;
+
+    class Visitor {
+    public:
+        virtual ~Visitor() {
+        }
+
+        virtual void visit(size_t sample_index, const AnnotationMap& annotations) = 0;
+    };
+
+    AnnotationIndexedReader(const std::string& filepath);
+
+    virtual ~AnnotationIndexedReader() {
+    }
+
+    size_t sampleCount() const {
+        return sample_count_;
+    }
+
+    // returns the sample index or -1 if there is no sample with this name
+    int findSample(const std::string& sample_name) const;
+
+    AnnotationMap readSample(size_t sample_index);
+
+    AnnotationMap readSample(const std::string& sample_name);
+
+    // read the samples in [begin, end)
+    std::vector<AnnotationMap> readRange(size_t begin, size_t end);
+
+    // read the polygons with the given label of the samples in [begin, end)
+    std::vector<LabeledPolygon> readLabel(const std::string& label, size_t begin = 0, size_t end = size_t(-1));
+
+    // visit every sample in order, only one sample is held in memory at a time
+    void visit(Visitor& visitor);
+
+private:
+
+    struct Entry {
+        Entry()
+            : offset(0)
+            , length(0)
+        {
+        }
+
+        std::string name;
+        uint64_t offset;
+        uint64_t length;
+        std::set<std::string> labels;
+    };
+
+    void buildYamlIndex();
+    void applyJournal();
+    void parseSample(size_t sample_index, AnnotationMap& annotations);
+
+    std::string filepath_;
+    std::ifstream in_;
+    boost::scoped_ptr<AnnotationBinaryReader> binary_reader_;
+
+    std::vector<Entry> entries_;
+    std::map<std::string, size_t> names_;
+    std::map<size_t, AnnotationMap> journal_samples_;
+    size_t sample_count_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationIndexedReader_hpp */
@@ -0,0 +1,178 @@
+#include <sstream>
+#include "AnnotationJournal.hpp"
+#include "AnnotationStore.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+bool readName(std::istringstream& in, std::string& name) {
+    size_t length;
+    char separator;
+
+    if (!(in >> length) || !in.get(separator) || separator != ':') {
+        return false;
+    }
+
+    name.resize(length);
+    if (length > 0) {
+        in.read(&name[0], length);
+    }
+    return !in.fail();
+}
+
+void setAnnotation(std::vector<AnnotationFileReader::AnnotationMap>& annotations, int sample_index,
+                   const std::string& name, const std::vector<cv::Point2f>& points)
+{
+    if (sample_index >= (int)annotations.size()) {
+        annotations.resize(sample_index + 1);
+    }
+    annotations[sample_index][name] = points;
+}
+
+void removeAnnotation(std::vector<AnnotationFileReader::AnnotationMap>& annotations, int sample_index, const std::string& name) {
+    if (sample_index < (int)annotations.size()) {
+        annotations[sample_index].erase(name);
+    }
+}
+
+void setAnnotation(AnnotationStore& annotations, int sample_index, const std::string& name, const std::vector<cv::Point2f>& points) {
+    annotations.set(sample_index, name, points);
+}
+
+void removeAnnotation(AnnotationStore& annotations, int sample_index, const std::string& name) {
+    annotations.remove(sample_index, name);
+}
+
+// the records are applied through setAnnotation/removeAnnotation of the annotation container
+template <typename Annotations>
+size_t replayRecords(const std::string& journal_filepath, Annotations& annotations) {
+    std::ifstream in(journal_filepath.c_str());
+    std::string line;
+    size_t count = 0;
+
+    while (std::getline(in, line)) {
+        std::istringstream record(line);
+        std::string operation;
+        int sample_index;
+        std::string name;
+
+        // a record that can not be parsed (e.g. a truncated last line) is ignored
+        if (!(record >> operation >> sample_index) || sample_index < 0 || !readName(record, name)) {
+            continue;
+        }
+
+        if (operation == "set") {
+            size_t point_count;
+            if (!(record >> point_count) || point_count > line.size()) {
+                continue;
+            }
+
+            std::vector<cv::Point2f> points(point_count);
+            for (size_t i = 0; i < point_count && record; i++) {
+                record >> points[i].x >> points[i].y;
+            }
+
+            if (record.fail()) {
+                continue;
+            }
+
+            setAnnotation(annotations, sample_index, name, points);
+            count++;
+        }
+        else if (operation == "remove") {
+            removeAnnotation(annotations, sample_index, name);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+} /* namespace */
+
+void AnnotationJournal::open(const std::string& annotation_filepath) {
+    close();
+
+    filepath_ = journalFilePath(annotation_filepath);
+
+    std::ifstream in(filepath_.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) record_count_++;
+    }
+    in.close();
+
+    out_.open(filepath_.c_str(), std::ios::out | std::ios::app);
+    out_.precision(9);
+}
+
+void AnnotationJournal::close() {
+    if (out_.is_open()) {
+        out_.close();
+    }
+    out_.clear();
+    record_count_ = 0;
+}
+
+void AnnotationJournal::appendSet(int sample_index, const std::string& name, const std::vector<cv::Point2f>& points) {
+    if (!out_.is_open()) {
+        return;
+    }
+
+    out_ << "set " << sample_index << " " << name.size() << ":" << name << " " << points.size();
+    for (size_t i = 0; i < points.size(); i++) {
+        out_ << " " << points[i].x << " " << points[i].y;
+    }
+    out_ << "\n";
+    out_.flush();
+    record_count_++;
+}
+
+void AnnotationJournal::appendRemove(int sample_index, const std::string& name) {
+    if (!out_.is_open()) {
+        return;
+    }
+
+    out_ << "remove " << sample_index << " " << name.size() << ":" << name << "\n";
+    out_.flush();
+    record_count_++;
+}
+
+void AnnotationJournal::clear() {
+    if (!out_.is_open()) {
+        return;
+    }
+
+    out_.close();
+    out_.clear();
+    out_.open(filepath_.c_str(), std::ios::out | std::ios::trunc);
+    record_count_ = 0;
+}
+
+size_t AnnotationJournal::replay(const std::string& journal_filepath,
+                                 std::vector<AnnotationFileReader::AnnotationMap>& annotations)
+{
+    return replayRecords(journal_filepath, annotations);
+}
+
+size_t AnnotationJournal::replay(const std::string& journal_filepath, AnnotationStore& annotations) {
+    return replayRecords(journal_filepath, annotations);
+}
+
+void AnnotationJournal::touchedSamples(const std::string& journal_filepath, std::set<int>& sample_indices) {
+    std::ifstream in(journal_filepath.c_str());
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::istringstream record(line);
+        std::string operation;
+        int sample_index;
+
+        if ((record >> operation >> sample_index) && sample_index >= 0) {
+            sample_indices.insert(sample_index);
+        }
+    }
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,79 @@
+#ifndef sonarlog_annotation_AnnotationJournal_hpp
+#define sonarlog_annotation_AnnotationJournal_hpp
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+#include "AnnotationFileReader.hpp"
+
+namespace sonarlog_annotation {
+
+class AnnotationStore;
+
+/*
+ * Append-only log of the annotation edits.
+ *
+ * Every edit is appended as one text record to the journal kept next to
+ * the annotation file, so an edit does not rewrite the whole file. The
+ * records are replayed over the annotation file when it is read, and
+ * cleared once the annotation file is rewritten (compacted).
+ *
+ * Record format, one per line:
+ *   set <sample> <name length>:<name> <point count> <x0> <y0> ...
+ *   remove <sample> <name length>:<name>
+ */
+class AnnotationJournal {
+public:
+
+    AnnotationJournal()
+        : record_count_(0)
+    {
+    }
+
+    virtual ~AnnotationJournal() {
+        close();
+    }
+
+    void open(const std::string& annotation_filepath);
+
+    void close();
+
+    bool isOpen() const {
+        return out_.is_open();
+    }
+
+    void appendSet(int sample_index, const std::string& name, const std::vector<cv::Point2f>& points);
+
+    void appendRemove(int sample_index, const std::string& name);
+
+    // discard the records, called after the annotation file was rewritten
+    void clear();
+
+    size_t recordCount() const {
+        return record_count_;
+    }
+
+    static std::string journalFilePath(const std::string& annotation_filepath) {
+        return annotation_filepath + ".journal";
+    }
+
+    // apply the records of the journal file over the annotations
+    static size_t replay(const std::string& journal_filepath,
+                         std::vector<AnnotationFileReader::AnnotationMap>& annotations);
+
+    static size_t replay(const std::string& journal_filepath, AnnotationStore& annotations);
+
+    // collect the sample indices changed by the records of the journal file
+    static void touchedSamples(const std::string& journal_filepath, std::set<int>& sample_indices);
+
+private:
+
+    std::string filepath_;
+    std::ofstream out_;
+    size_t record_count_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationJournal_hpp */
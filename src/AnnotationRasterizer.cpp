@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "AnnotationRasterizer.hpp"
+
+namespace sonarlog_annotation {
+
+void AnnotationRasterizer::fillPolygon(const cv::Point2f* points, size_t count, uchar value, cv::Mat& mask) {
+    CV_Assert(mask.type() == CV_8UC1);
+
+    if (count < 3) {
+        return;
+    }
+
+    edges_.clear();
+
+    for (size_t i = 0; i < count; i++) {
+        cv::Point2f p0 = points[i];
+        cv::Point2f p1 = points[(i + 1) % count];
+
+        if (p0.y == p1.y) {
+            continue;
+        }
+
+        if (p0.y > p1.y) {
+            std::swap(p0, p1);
+        }
+
+        // the edge covers the rows whose pixel center lies in [p0.y, p1.y)
+        Edge edge;
+        edge.first_row = std::max(0, (int)std::ceil(p0.y - 0.5f));
+        edge.last_row = std::min(mask.rows, (int)std::ceil(p1.y - 0.5f));
+
+        if (edge.first_row >= edge.last_row) {
+            continue;
+        }
+
+        edge.dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+        edge.x = p0.x + (edge.first_row + 0.5f - p0.y) * edge.dxdy;
+        edges_.push_back(edge);
+    }
+
+    if (edges_.empty()) {
+        return;
+    }
+
+    std::sort(edges_.begin(), edges_.end());
+
+    active_edges_.clear();
+    size_t next_edge = 0;
+
+    for (int y = edges_[0].first_row; y < mask.rows; y++) {
+        while (next_edge < edges_.size() && edges_[next_edge].first_row == y) {
+            active_edges_.push_back(&edges_[next_edge++]);
+        }
+
+        crossings_.clear();
+        size_t active = 0;
+        for (size_t i = 0; i < active_edges_.size(); i++) {
+            Edge* edge = active_edges_[i];
+            if (edge->last_row > y) {
+                crossings_.push_back(edge->x);
+                edge->x += edge->dxdy;
+                active_edges_[active++] = edge;
+            }
+        }
+        active_edges_.resize(active);
+
+        if (active_edges_.empty() && next_edge == edges_.size()) {
+            break;
+        }
+
+        std::sort(crossings_.begin(), crossings_.end());
+
+        uchar* row = mask.ptr<uchar>(y);
+        for (size_t i = 0; i + 1 < crossings_.size(); i += 2) {
+            int x_begin = std::max(0, (int)std::ceil(crossings_[i] - 0.5f));
+            int x_end = std::min(mask.cols, (int)std::ceil(crossings_[i + 1] - 0.5f));
+            if (x_begin < x_end) {
+                memset(row + x_begin, value, x_end - x_begin);
+            }
+        }
+    }
+}
+
+void AnnotationRasterizer::rasterize(const AnnotationFileReader::AnnotationMap& annotations,
+                                     const LabelValues& label_values,
+                                     cv::Mat& mask)
+{
+    AnnotationFileReader::AnnotationMap::const_iterator it;
+    for (it = annotations.begin(); it != annotations.end(); it++) {
+        LabelValues::const_iterator value_it = label_values.find(it->first);
+        if (value_it != label_values.end()) {
+            fillPolygon(it->second, value_it->second, mask);
+        }
+    }
+}
+
+void AnnotationRasterizer::rasterizeCartesian(const AnnotationFileReader::AnnotationMap& annotations,
+                                              const LabelValues& label_values,
+                                              const cv::Size& size,
+                                              cv::Mat& mask)
+{
+    mask.create(size, CV_8UC1);
+    mask.setTo(cv::Scalar(0));
+    rasterize(annotations, label_values, mask);
+}
+
+void AnnotationRasterizer::rasterizePolar(const AnnotationFileReader::AnnotationMap& annotations,
+                                          const LabelValues& label_values,
+                                          const cv::Size& cart_size,
+                                          const std::vector<int>& cart_to_polar,
+                                          int beam_count,
+                                          int bin_count,
+                                          cv::Mat& polar_mask)
+{
+    rasterizeCartesian(annotations, label_values, cart_size, cart_mask_);
+    cartesianToPolar(cart_mask_, cart_to_polar, beam_count, bin_count, polar_mask);
+}
+
+void AnnotationRasterizer::cartesianToPolar(const cv::Mat& cart_mask,
+                                            const std::vector<int>& cart_to_polar,
+                                            int beam_count,
+                                            int bin_count,
+                                            cv::Mat& polar_mask)
+{
+    CV_Assert(cart_mask.type() == CV_8UC1 && cart_mask.isContinuous());
+    CV_Assert(cart_to_polar.size() == cart_mask.total());
+
+    const int polar_total = beam_count * bin_count;
+
+    polar_mask.create(beam_count, bin_count, CV_8UC1);
+    polar_mask.setTo(cv::Scalar(0));
+
+    // the bins near the sonar cover less than one pixel, the ones not hit
+    // by any pixel take the value of the closest hit bin of the same beam
+    std::vector<uchar> hit(polar_total, 0);
+
+    const uchar* cart_data = cart_mask.ptr<uchar>();
+    uchar* polar_data = polar_mask.ptr<uchar>();
+
+    for (size_t i = 0; i < cart_to_polar.size(); i++) {
+        int polar_index = cart_to_polar[i];
+        if (polar_index >= 0 && polar_index < polar_total) {
+            polar_data[polar_index] = std::max(polar_data[polar_index], cart_data[i]);
+            hit[polar_index] = 1;
+        }
+    }
+
+    for (int beam = 0; beam < beam_count; beam++) {
+        uchar* row = polar_data + beam * bin_count;
+        const uchar* row_hit = &hit[beam * bin_count];
+
+        int last_hit = -1;
+        for (int bin = 0; bin < bin_count; bin++) {
+            if (row_hit[bin]) {
+                // fill the gap up to the previous hit, split between both ends
+                int gap_begin = (last_hit == -1) ? 0 : last_hit + 1;
+                for (int k = gap_begin; k < bin; k++) {
+                    row[k] = (last_hit != -1 && k - last_hit <= bin - k) ? row[last_hit] : row[bin];
+                }
+                last_hit = bin;
+            }
+        }
+
+        if (last_hit != -1) {
+            for (int k = last_hit + 1; k < bin_count; k++) {
+                row[k] = row[last_hit];
+            }
+        }
+    }
+}
+
+} /* namespace sonarlog_annotation */
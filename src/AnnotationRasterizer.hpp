@@ -0,0 +1,94 @@
+#ifndef sonarlog_annotation_AnnotationRasterizer_hpp
+#define sonarlog_annotation_AnnotationRasterizer_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include "AnnotationFileReader.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Fills annotation polygons into 8-bit label masks.
+ *
+ * The polygons are scan converted with an active edge list (even-odd
+ * rule, pixel centers) and every span is written with a single memset.
+ * The edge buffers are kept between calls, so one rasterizer should be
+ * reused for all the polygons of a frame and across frames. A rasterizer
+ * is not thread safe.
+ */
+class AnnotationRasterizer {
+public:
+
+    typedef std::map<std::string, uchar> LabelValues;
+
+    // labels an 8-bit mask can tell apart, 0 is the background
+    static const size_t kMaxLabels = 255;
+
+    AnnotationRasterizer() {
+    }
+
+    virtual ~AnnotationRasterizer() {
+    }
+
+    // fill one polygon into a CV_8UC1 mask
+    void fillPolygon(const cv::Point2f* points, size_t count, uchar value, cv::Mat& mask);
+
+    void fillPolygon(const std::vector<cv::Point2f>& points, uchar value, cv::Mat& mask) {
+        if (!points.empty()) fillPolygon(&points[0], points.size(), value, mask);
+    }
+
+    // fill the polygons of a sample, labels without a value are skipped
+    void rasterize(const AnnotationFileReader::AnnotationMap& annotations,
+                   const LabelValues& label_values,
+                   cv::Mat& mask);
+
+    // rasterize in cartesian image coordinates into a mask of the given size
+    void rasterizeCartesian(const AnnotationFileReader::AnnotationMap& annotations,
+                            const LabelValues& label_values,
+                            const cv::Size& size,
+                            cv::Mat& mask);
+
+    /*
+     * Rasterize into a polar mask with one row per beam and one column per
+     * bin. cart_to_polar holds the polar index (beam * bin_count + bin) of
+     * every cartesian pixel of an image with the given size, or -1 outside
+     * of the sonar fan.
+     */
+    void rasterizePolar(const AnnotationFileReader::AnnotationMap& annotations,
+                        const LabelValues& label_values,
+                        const cv::Size& cart_size,
+                        const std::vector<int>& cart_to_polar,
+                        int beam_count,
+                        int bin_count,
+                        cv::Mat& polar_mask);
+
+    // map a cartesian mask to the polar domain, see rasterizePolar
+    static void cartesianToPolar(const cv::Mat& cart_mask,
+                                 const std::vector<int>& cart_to_polar,
+                                 int beam_count,
+                                 int bin_count,
+                                 cv::Mat& polar_mask);
+
+private:
+
+    struct Edge {
+        int first_row;
+        int last_row;
+        float x;
+        float dxdy;
+
+        bool operator<(const Edge& other) const {
+            return first_row < other.first_row;
+        }
+    };
+
+    std::vector<Edge> edges_;
+    std::vector<Edge*> active_edges_;
+    std::vector<float> crossings_;
+    cv::Mat cart_mask_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationRasterizer_hpp */
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include "AnnotationStore.hpp"
+
+namespace sonarlog_annotation {
+
+// below this many unused points the buffer is not worth compacting
+static const size_t kMinCompactPoints = 4096;
+
+AnnotationStore::AnnotationStore()
+    : unused_points_(0)
+{
+}
+
+void AnnotationStore::resize(size_t sample_count) {
+    for (size_t sample_index = sample_count; sample_index < samples_.size(); sample_index++) {
+        for (size_t i = 0; i < samples_[sample_index].size(); i++) {
+            unused_points_ += samples_[sample_index][i].size;
+        }
+    }
+
+    samples_.resize(sample_count);
+    compact();
+}
+
+void AnnotationStore::clear() {
+    std::vector<std::vector<Polygon> >().swap(samples_);
+    std::vector<cv::Point2f>().swap(points_);
+    unused_points_ = 0;
+    labels_.clear();
+    label_ids_.clear();
+}
+
+void AnnotationStore::swap(AnnotationStore& other) {
+    samples_.swap(other.samples_);
+    points_.swap(other.points_);
+    std::swap(unused_points_, other.unused_points_);
+    labels_.swap(other.labels_);
+    label_ids_.swap(other.label_ids_);
+}
+
+AnnotationStore::LabelId AnnotationStore::internLabel(const std::string& name) {
+    std::map<std::string, LabelId>::const_iterator it = label_ids_.find(name);
+    if (it != label_ids_.end()) {
+        return it->second;
+    }
+
+    LabelId label_id = labels_.size();
+    labels_.push_back(name);
+    label_ids_.insert(std::make_pair(name, label_id));
+    return label_id;
+}
+
+int AnnotationStore::findLabel(const std::string& name) const {
+    std::map<std::string, LabelId>::const_iterator it = label_ids_.find(name);
+    return (it == label_ids_.end()) ? -1 : (int)it->second;
+}
+
+AnnotationStore::PolygonView AnnotationStore::polygon(size_t sample_index, size_t polygon_index) const {
+    const Polygon& polygon = samples_[sample_index][polygon_index];
+
+    PolygonView view;
+    view.label_id = polygon.label_id;
+    view.points = (polygon.size) ? &points_[polygon.offset] : NULL;
+    view.size = polygon.size;
+    return view;
+}
+
+int AnnotationStore::findPolygon(size_t sample_index, const std::string& name) const {
+    size_t position = polygonPosition(sample_index, name);
+    return (position < polygonCount(sample_index) && polygonLabel(sample_index, position) == name) ? (int)position : -1;
+}
+
+size_t AnnotationStore::polygonPosition(size_t sample_index, const std::string& name) const {
+    size_t first = 0;
+    size_t last = polygonCount(sample_index);
+
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if (polygonLabel(sample_index, middle) < name) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+void AnnotationStore::set(size_t sample_index, const std::string& name, const cv::Point2f* points, size_t size) {
+    // the points may come from the buffer itself, which can be reallocated below
+    if (size && !points_.empty() && points >= &points_[0] && points < &points_[0] + points_.size()) {
+        std::vector<cv::Point2f> copy(points, points + size);
+        set(sample_index, name, copy);
+        return;
+    }
+
+    if (sample_index >= samples_.size()) {
+        samples_.resize(sample_index + 1);
+    }
+
+    std::vector<Polygon>& polygons = samples_[sample_index];
+    size_t position = polygonPosition(sample_index, name);
+
+    if (position < polygons.size() && labels_[polygons[position].label_id] == name) {
+        Polygon& polygon = polygons[position];
+
+        if (polygon.size == size) {
+            std::copy(points, points + size, points_.begin() + polygon.offset);
+            return;
+        }
+
+        unused_points_ += polygon.size;
+        polygon.offset = points_.size();
+        polygon.size = size;
+        points_.insert(points_.end(), points, points + size);
+        compact();
+        return;
+    }
+
+    Polygon polygon;
+    polygon.label_id = internLabel(name);
+    polygon.offset = points_.size();
+    polygon.size = size;
+    points_.insert(points_.end(), points, points + size);
+    polygons.insert(polygons.begin() + position, polygon);
+}
+
+bool AnnotationStore::remove(size_t sample_index, const std::string& name) {
+    int position = findPolygon(sample_index, name);
+    if (position == -1) {
+        return false;
+    }
+
+    std::vector<Polygon>& polygons = samples_[sample_index];
+    unused_points_ += polygons[position].size;
+    polygons.erase(polygons.begin() + position);
+
+    if (polygons.empty()) {
+        std::vector<Polygon>().swap(polygons);
+    }
+
+    compact();
+    return true;
+}
+
+void AnnotationStore::assignSample(size_t sample_index, const AnnotationStore& other) {
+    if (&other == this) {
+        return;
+    }
+
+    if (sample_index < samples_.size()) {
+        std::vector<Polygon>& polygons = samples_[sample_index];
+        for (size_t i = 0; i < polygons.size(); i++) {
+            unused_points_ += polygons[i].size;
+        }
+        std::vector<Polygon>().swap(polygons);
+    }
+
+    for (size_t i = 0; i < other.polygonCount(sample_index); i++) {
+        PolygonView polygon = other.polygon(sample_index, i);
+        set(sample_index, other.polygonLabel(sample_index, i), polygon.points, polygon.size);
+    }
+
+    compact();
+}
+
+size_t AnnotationStore::byteSize() const {
+    size_t size = sizeof(*this) +
+                  samples_.capacity() * sizeof(std::vector<Polygon>) +
+                  points_.capacity() * sizeof(cv::Point2f) +
+                  labels_.capacity() * sizeof(std::string);
+
+    for (size_t sample_index = 0; sample_index < samples_.size(); sample_index++) {
+        size += samples_[sample_index].capacity() * sizeof(Polygon);
+    }
+
+    for (size_t label_id = 0; label_id < labels_.size(); label_id++) {
+        size += 2 * labels_[label_id].capacity();
+    }
+
+    return size;
+}
+
+void AnnotationStore::compact() {
+    if (unused_points_ < kMinCompactPoints || unused_points_ <= pointCount()) {
+        return;
+    }
+
+    // rewrite the buffer in sample order, only the used points are kept
+    std::vector<cv::Point2f> points;
+    points.reserve(pointCount());
+
+    for (size_t sample_index = 0; sample_index < samples_.size(); sample_index++) {
+        for (size_t i = 0; i < samples_[sample_index].size(); i++) {
+            Polygon& polygon = samples_[sample_index][i];
+            size_t offset = points.size();
+            points.insert(points.end(), points_.begin() + polygon.offset, points_.begin() + polygon.offset + polygon.size);
+            polygon.offset = offset;
+        }
+    }
+
+    points_.swap(points);
+    unused_points_ = 0;
+}
+
+} /* namespace sonarlog_annotation */
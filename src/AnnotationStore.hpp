@@ -0,0 +1,135 @@
+#ifndef sonarlog_annotation_AnnotationStore_hpp
+#define sonarlog_annotation_AnnotationStore_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+namespace sonarlog_annotation {
+
+/*
+ * Annotations of every sample of a log in contiguous storage.
+ *
+ * Label names are interned and each polygon refers to its label by id.
+ * The points of all polygons live in one flat buffer, a polygon keeps the
+ * offset and size of its points. The polygons of a sample are kept sorted
+ * by label name.
+ *
+ * A polygon replaced by one of the same size is overwritten in place,
+ * otherwise its previous points are left unused in the buffer, which is
+ * compacted once the unused points outnumber the used ones.
+ *
+ * The views returned by the store are invalidated by any change. The
+ * store is not thread safe.
+ */
+class AnnotationStore {
+public:
+
+    typedef uint32_t LabelId;
+
+    struct PolygonView {
+        LabelId label_id;
+        const cv::Point2f* points;
+        size_t size;
+
+        const cv::Point2f* begin() const {
+            return points;
+        }
+
+        const cv::Point2f* end() const {
+            return points + size;
+        }
+    };
+
+    AnnotationStore();
+
+    size_t sampleCount() const {
+        return samples_.size();
+    }
+
+    // samples past the new count are dropped
+    void resize(size_t sample_count);
+
+    void clear();
+
+    void swap(AnnotationStore& other);
+
+    LabelId internLabel(const std::string& name);
+
+    // returns the label id or -1 if the label was never interned
+    int findLabel(const std::string& name) const;
+
+    const std::string& label(LabelId label_id) const {
+        return labels_[label_id];
+    }
+
+    size_t labelCount() const {
+        return labels_.size();
+    }
+
+    bool isEmpty(size_t sample_index) const {
+        return sample_index >= samples_.size() || samples_[sample_index].empty();
+    }
+
+    size_t polygonCount(size_t sample_index) const {
+        return (sample_index < samples_.size()) ? samples_[sample_index].size() : 0;
+    }
+
+    PolygonView polygon(size_t sample_index, size_t polygon_index) const;
+
+    const std::string& polygonLabel(size_t sample_index, size_t polygon_index) const {
+        return labels_[samples_[sample_index][polygon_index].label_id];
+    }
+
+    // position of the polygon with the label in the sample, -1 if there is none
+    int findPolygon(size_t sample_index, const std::string& name) const;
+
+    // position a polygon with the label takes in the sample
+    size_t polygonPosition(size_t sample_index, const std::string& name) const;
+
+    bool contains(size_t sample_index, const std::string& name) const {
+        return findPolygon(sample_index, name) != -1;
+    }
+
+    // add or replace the polygon with the label, the sample list grows as needed
+    void set(size_t sample_index, const std::string& name, const cv::Point2f* points, size_t size);
+
+    void set(size_t sample_index, const std::string& name, const std::vector<cv::Point2f>& points) {
+        set(sample_index, name, (points.empty()) ? NULL : &points[0], points.size());
+    }
+
+    bool remove(size_t sample_index, const std::string& name);
+
+    // replace the polygons of the sample with those of the other store
+    void assignSample(size_t sample_index, const AnnotationStore& other);
+
+    size_t pointCount() const {
+        return points_.size() - unused_points_;
+    }
+
+    // bytes held by the store
+    size_t byteSize() const;
+
+private:
+
+    struct Polygon {
+        LabelId label_id;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    void compact();
+
+    std::vector<std::vector<Polygon> > samples_;
+    std::vector<cv::Point2f> points_;
+    size_t unused_points_;
+
+    std::vector<std::string> labels_;
+    std::map<std::string, LabelId> label_ids_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationStore_hpp */
@@ -1,40 +1,136 @@
+#include <exception>
 #include <opencv2/opencv.hpp>
-#include <rock_util/LogReader.hpp>
-#include <rock_util/Utilities.hpp>
-#include <sonar_processing/ImageFiltering.hpp>
-#include <sonar_processing/SonarImagePreprocessing.hpp>
 #include "AnnotationFileReader.hpp"
 #include "AnnotationWindow.hpp"
+#include "Profiler.hpp"
 
 namespace sonarlog_annotation {
 
+// number of journal records that triggers a rewrite of the annotation file
+static const size_t kJournalCompactionThreshold = 1000;
+
+// number of samples indexed between two updates of the tree
+static const size_t kLoadBatchSize = 256;
+
+// the resident frames are kept 8-bit encoded, four times as many fit in
+// the memory their float bins would take
+static const size_t kResidentBytes = 64 * 1024 * 1024;
+
+// farthest a vertex is moved to bring it inside the sonar fan, in pixels
+static const float kMaxSnapDistance = 10.0f;
+
+// refresh period of the profiler overlay and number of stages it shows
+static const int kProfilerOverlayIntervalMs = 500;
+static const int kProfilerOverlayStages = 5;
+
+// stride units of the navigation controls
+enum StrideUnit {
+    kStrideFrames = 0,
+    kStrideSeconds
+};
+
+// vertex drags reach the tree at most once per display frame
+static const int kEditFlushIntervalMs = 16;
+static const int kEditSessionIdleMs = 300;
+
 void LoadSonarLogWorker::performLoadSonarLog() {
-    annotation_window_->loadSonarLog();
-    emit finished();
+    running_generation_ = generation_;
+
+    // a corrupt annotation file or log must not take the thread down, the
+    // window is told and the progress dialog still closes
+    try {
+        annotation_window_->loadSonarLog();
+    }
+    catch (const std::exception& e) {
+        emit loadFailed(running_generation_, QString::fromStdString(e.what()));
+    }
+    catch (...) {
+        emit loadFailed(running_generation_, "unknown error");
+    }
+
+    emit finished(running_generation_);
 }
 
 
 AnnotationWindow::AnnotationWindow(QWidget *parent)
-    : current_index_(-1)
+    : open_logfile_button_(NULL)
+    , enable_enhancement_button_(NULL)
+    , enable_preprocessing_button_(NULL)
+    , palette_combobox_(NULL)
+    , gamma_spinbox_(NULL)
+    , enable_profiling_button_(NULL)
+    , export_trace_button_(NULL)
+    , profiler_label_(NULL)
+    , jump_time_edit_(NULL)
+    , jump_time_button_(NULL)
+    , stride_spinbox_(NULL)
+    , stride_unit_combobox_(NULL)
+    , stride_backward_button_(NULL)
+    , stride_forward_button_(NULL)
+    , treeview_(NULL)
+    , image_picker_tool_(NULL)
+    , sample_store_(kResidentBytes, kBinEncoding8Bit)
+    , sample_tree_model_(&sample_store_, &annotations_)
+    , renderer_sample_index_(-1)
+    , frame_prefetcher_(&sample_store_, &frame_cache_)
+    , load_sonarlog_progress_(NULL)
+    , current_index_(-1)
     , current_annotation_name_("")
     , load_sonarlog_worker_(this)
-    , load_sonarlog_progress_(NULL)
     , last_annotation_name_("")
-    , enable_enhancement_button_(NULL)
-    , enable_preprocessing_button_(NULL)
+    , edit_sample_index_(-1)
+    , edit_pending_(false)
 {
     setupLoadSonarLogWorker();
+    setupFramePrefetcher();
     setupTreeView();
     setupRightDockWidget();
     setupImagePickerTool();
+    setupEditTimers();
+    setupProfilerOverlay();
 }
 
 void AnnotationWindow::setupLoadSonarLogWorker() {
     load_sonarlog_worker_.moveToThread(&thread_);
     connect(&thread_, SIGNAL(started()), &load_sonarlog_worker_, SLOT(performLoadSonarLog()));
     connect(&load_sonarlog_worker_, SIGNAL(loadSonarLogRequested()), &thread_, SLOT(start()));
-    connect(&load_sonarlog_worker_, SIGNAL(finished()), &thread_, SLOT(quit()), Qt::DirectConnection);
-    connect(&load_sonarlog_worker_, SIGNAL(finished()), this, SLOT(loadLogFileFinished()));
+    connect(&load_sonarlog_worker_, SIGNAL(finished(int)), &thread_, SLOT(quit()), Qt::DirectConnection);
+    connect(&load_sonarlog_worker_, SIGNAL(finished(int)), this, SLOT(loadLogFileFinished(int)));
+    connect(&load_sonarlog_worker_, SIGNAL(loadFailed(int, const QString&)), this, SLOT(loadLogFileFailed(int, const QString&)));
+    connect(&load_sonarlog_worker_, SIGNAL(samplesLoaded(int, int, int)), this, SLOT(samplesLoaded(int, int, int)));
+}
+
+void AnnotationWindow::setupFramePrefetcher() {
+    connect(&frame_prefetcher_, SIGNAL(frameReady(int, int, const cv::Mat&)), this, SLOT(prefetchedFrameReady(int, int, const cv::Mat&)));
+}
+
+void AnnotationWindow::prefetchedFrameReady(int sample_index, int mode, const cv::Mat& frame) {
+    frame_cache_.insert(sample_index, (DisplayMode)mode, frame);
+}
+
+void AnnotationWindow::setupEditTimers() {
+    edit_flush_timer_.setSingleShot(true);
+    edit_flush_timer_.setInterval(kEditFlushIntervalMs);
+    connect(&edit_flush_timer_, SIGNAL(timeout()), this, SLOT(flushEdit()));
+
+    // a drag whose release was not seen ends once the vertex stops moving
+    edit_session_timer_.setSingleShot(true);
+    edit_session_timer_.setInterval(kEditSessionIdleMs);
+    connect(&edit_session_timer_, SIGNAL(timeout()), this, SLOT(endEditSession()));
+}
+
+void AnnotationWindow::setupProfilerOverlay() {
+    profiler_label_ = new QLabel();
+    statusBar()->addPermanentWidget(profiler_label_);
+    profiler_label_->setVisible(Profiler::enabled());
+
+    profiler_timer_.setInterval(kProfilerOverlayIntervalMs);
+    connect(&profiler_timer_, SIGNAL(timeout()), this, SLOT(updateProfilerOverlay()));
+
+    enable_profiling_button_->setChecked(Profiler::enabled());
+    if (Profiler::enabled()) {
+        profiler_timer_.start();
+    }
 }
 
 void AnnotationWindow::setupImagePickerTool() {
@@ -58,11 +154,51 @@ void AnnotationWindow::setupRightDockWidget() {
     enable_enhancement_button_ = new QCheckBox("enhancement");
     enable_preprocessing_button_ = new QCheckBox("preprocessing");
 
+    palette_combobox_ = new QComboBox();
+    for (int i = 0; i < FrameColorizer::kPaletteCount; i++) {
+        palette_combobox_->addItem(FrameColorizer::paletteName((DisplayPalette)i));
+    }
+
+    gamma_spinbox_ = new QDoubleSpinBox();
+    gamma_spinbox_->setPrefix("gamma ");
+    gamma_spinbox_->setRange(0.2, 5.0);
+    gamma_spinbox_->setSingleStep(0.1);
+    gamma_spinbox_->setValue(1.0);
+
+    enable_profiling_button_ = new QCheckBox("profiling");
+    export_trace_button_ = new QPushButton("Export Trace");
+
+    jump_time_edit_ = new QDateTimeEdit();
+    jump_time_edit_->setDisplayFormat("yyyy-MM-dd hh:mm:ss.zzz");
+    jump_time_button_ = new QPushButton("Jump to Time");
+
+    stride_spinbox_ = new QSpinBox();
+    stride_spinbox_->setRange(1, 100000);
+    stride_spinbox_->setValue(10);
+    stride_unit_combobox_ = new QComboBox();
+    stride_unit_combobox_->addItem("frames");
+    stride_unit_combobox_->addItem("seconds");
+    stride_backward_button_ = new QPushButton("<<");
+    stride_forward_button_ = new QPushButton(">>");
+
+    QHBoxLayout *stride_layout = new QHBoxLayout();
+    stride_layout->addWidget(stride_backward_button_);
+    stride_layout->addWidget(stride_spinbox_);
+    stride_layout->addWidget(stride_unit_combobox_);
+    stride_layout->addWidget(stride_forward_button_);
+
     QFrame *frame = new QFrame();
     layout->addWidget(open_logfile_button_);
     layout->addWidget(enable_enhancement_button_);
     layout->addWidget(enable_preprocessing_button_);
-    layout->addWidget(treewidget_);
+    layout->addWidget(palette_combobox_);
+    layout->addWidget(gamma_spinbox_);
+    layout->addWidget(enable_profiling_button_);
+    layout->addWidget(export_trace_button_);
+    layout->addWidget(jump_time_edit_);
+    layout->addWidget(jump_time_button_);
+    layout->addLayout(stride_layout);
+    layout->addWidget(treeview_);
 
     frame->setLayout(layout);
     dock->setWidget(frame);
@@ -72,126 +208,123 @@ void AnnotationWindow::setupRightDockWidget() {
     connect(open_logfile_button_, SIGNAL(clicked(bool)), this, SLOT(openLogFileClicked(bool)));
     connect(enable_enhancement_button_, SIGNAL(stateChanged(int)), this, SLOT(enableEnhancementStateChanged(int)));
     connect(enable_preprocessing_button_, SIGNAL(stateChanged(int)), this, SLOT(enablePreprocessingStateChanged(int)));
-
-    setTabOrder(treewidget_, open_logfile_button_);
+    connect(palette_combobox_, SIGNAL(currentIndexChanged(int)), this, SLOT(paletteChanged(int)));
+    connect(gamma_spinbox_, SIGNAL(valueChanged(double)), this, SLOT(gammaChanged(double)));
+    connect(enable_profiling_button_, SIGNAL(stateChanged(int)), this, SLOT(enableProfilingStateChanged(int)));
+    connect(export_trace_button_, SIGNAL(clicked(bool)), this, SLOT(exportTraceClicked(bool)));
+    connect(jump_time_button_, SIGNAL(clicked(bool)), this, SLOT(jumpToTimeClicked(bool)));
+    connect(stride_backward_button_, SIGNAL(clicked(bool)), this, SLOT(strideBackwardClicked(bool)));
+    connect(stride_forward_button_, SIGNAL(clicked(bool)), this, SLOT(strideForwardClicked(bool)));
+
+    setTabOrder(treeview_, open_logfile_button_);
     addDockWidget(Qt::LeftDockWidgetArea, dock);
 }
 
 void AnnotationWindow::setupTreeView() {
-    treewidget_ = new QTreeWidget();
-    treewidget_->setHeaderItem(createItem("Name", "Value"));
-    treewidget_->setFocus();
-    treewidget_->installEventFilter(this);
-    connect(treewidget_, SIGNAL(currentItemChanged(QTreeWidgetItem*, QTreeWidgetItem*)),
-            this, SLOT(currentItemChanged(QTreeWidgetItem*, QTreeWidgetItem*)));
+    treeview_ = new QTreeView();
+    treeview_->setModel(&sample_tree_model_);
+    treeview_->setUniformRowHeights(true);
+    treeview_->setFocus();
+    treeview_->installEventFilter(this);
+    connect(treeview_->selectionModel(), SIGNAL(currentChanged(const QModelIndex&, const QModelIndex&)),
+            this, SLOT(currentIndexChanged(const QModelIndex&, const QModelIndex&)));
 }
 
-void AnnotationWindow::loadSamples(const QString& logfilepath, QList<base::samples::Sonar>& samples) {
-
-    rock_util::LogReader reader(logfilepath.toStdString());
-    rock_util::LogStream stream = reader.stream(stream_name_.toStdString());
+void AnnotationWindow::loadSamples(const QString& logfilepath) {
+    ScopedTimer timer("window.load_samples");
+    sample_store_.beginOpen(logfilepath.toStdString(),
+                            stream_name_.toStdString(),
+                            index_filepath_.toStdString());
 
-    do {
-        base::samples::Sonar sample;
-        stream.next<base::samples::Sonar>(sample);
-        samples_ << sample;
-        annotations_.append(AnnotationMap());
-    } while(stream.current_sample_index() < stream.total_samples());
+    annotations_.resize(sample_store_.totalSamples());
 }
 
 void AnnotationWindow::loadSonarImage(int sample_number, bool redraw) {
-    if (samples_.count() > 0 &&
-        sample_number < samples_.count() &&
+    if (sample_number >= 0 &&
+        (size_t)sample_number < sample_store_.size() &&
         (sample_number != current_index_ || redraw)) {
 
-        base::samples::Sonar sample = samples_.value(sample_number);
-        sonar_holder_.Reset(sample.bins,
-                            rock_util::Utilities::get_radians(sample.bearings),
-                            sample.beam_width.getRad(),
-                            sample.bin_count,
-                            sample.beam_count);
-
+        ScopedTimer timer("window.load_sonar_image");
+        DisplayMode mode = displayMode();
         cv::Mat cart_image;
-        if (enable_preprocessing_button_->checkState() == Qt::Checked) {
-            cv::Mat preprocessed_mask;
-            sonar_processing::SonarImagePreprocessing sonar_image_preprocessing;
-            sonar_image_preprocessing.Apply(sonar_holder_.cart_image(), sonar_holder_.cart_image_mask(), cart_image, preprocessed_mask, 0.5);
-        }
-        else if (enable_enhancement_button_->checkState() == Qt::Checked) {
-            sonar_processing::image_filtering::insonification_correction(sonar_holder_.cart_image(),
-                                                                         sonar_holder_.cart_image_mask(),
-                                                                         cart_image);
+
+        if (frame_cache_.find(sample_number, mode, cart_image)) {
+            // the remap table is still used to validate the annotation points
+            if (!rendererGeometryMatches(sample_number)) {
+                resetFrameRenderer(sample_number);
+            }
         }
         else {
-            sonar_holder_.cart_image().copyTo(cart_image);
+            resetFrameRenderer(sample_number);
+            frame_renderer_.render(mode, cart_image);
+            frame_cache_.insert(sample_number, mode, cart_image);
         }
 
-        cart_image.convertTo(cart_image, CV_8U, 255.0);
-        cv::cvtColor(cart_image, cart_image, CV_GRAY2BGR);
-        image_picker_tool_->loadImage(cart_image);
+        {
+            ScopedTimer display_timer("window.display_image");
+            image_picker_tool_->loadImage(cart_image);
+        }
 
         current_index_ = sample_number;
     }
 }
 
-void AnnotationWindow::loadTreeItems(const QList<base::samples::Sonar>& samples) {
-
-    if (samples.count()) {
-        QList<base::samples::Sonar>::const_iterator it;
-        for (it = samples.begin(); it != samples.end(); it++) {
-            treeitems_.append(createSampleTreeItem(*it, NULL));
-            annotation_treeitems_.append(NULL);
-        }
+void AnnotationWindow::resetFrameRenderer(int sample_number) {
+    SonarSamplePtr sample = sample_store_.sample(sample_number);
+    frame_renderer_.reset(*sample);
+    renderer_sample_index_ = sample_number;
+}
 
-        loadAnnotationTreeItems(annotations_);
-        treewidget_->insertTopLevelItems(0, treeitems_);
-        treewidget_->setCurrentItem(treeitems_[(current_index_ == -1) ? 0 : current_index_]);
+bool AnnotationWindow::rendererGeometryMatches(int sample_number) {
+    if (renderer_sample_index_ < 0 || (size_t)renderer_sample_index_ >= sample_store_.size()) {
+        return false;
     }
-}
 
-QTreeWidgetItem* AnnotationWindow::createSampleTreeItem(const base::samples::Sonar& sample, QTreeWidgetItem* parent) {
+    const SonarSampleIndexEntry& renderer_entry = sample_store_.entry(renderer_sample_index_);
+    const SonarSampleIndexEntry& entry = sample_store_.entry(sample_number);
+    return renderer_entry.bin_count == entry.bin_count &&
+           renderer_entry.beam_count == entry.beam_count &&
+           renderer_entry.beam_width == entry.beam_width;
+}
 
-    int num = samples_.count();
-    int number_of_digits = 1;
-    while (num /= 10) number_of_digits++;
+DisplayMode AnnotationWindow::displayMode() const {
+    if (enable_preprocessing_button_->checkState() == Qt::Checked) {
+        return kDisplayPreprocessed;
+    }
 
-    QString name = QString("Sample#%1").arg(treeitems_.count()+1, number_of_digits, 10, QChar('0'));
-    QString value = QString::fromStdString((sample.time.toString()));
-    QTreeWidgetItem *item = createItem(name, value);
-    item->addChild(createItem(QString("BinCount"), QString("%1").arg(sample.bin_count), item));
-    item->addChild(createItem(QString("BeamCount"), QString("%1").arg(sample.beam_count), item));
-    int image_width = cos(sample.beam_width.rad - M_PI_2) * sample.bin_count * 2.0;
-    item->addChild(createItem(QString("ImageWidth"), QString("%1").arg(image_width), item));
-    return item;
-}
+    if (enable_enhancement_button_->checkState() == Qt::Checked) {
+        return kDisplayEnhanced;
+    }
 
-QTreeWidgetItem* AnnotationWindow::createItem(const QString& name, const QString& value, QTreeWidgetItem* parent) {
-    QStringList strings;
-    strings << name << value;
-    return new QTreeWidgetItem(parent, strings);
+    return kDisplayRaw;
 }
 
-void AnnotationWindow::currentItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *previous) {
-    int index;
-    QTreeWidgetItem *item = current;
-    int isTopLevelItem = true;
+void AnnotationWindow::currentIndexChanged(const QModelIndex& current, const QModelIndex& previous) {
+    int index = sample_tree_model_.sampleOf(current);
 
-    while (item != NULL && (index = treewidget_->indexOfTopLevelItem(item)) == -1){
-        item = item->parent();
-        isTopLevelItem = false;
+    if (index != current_index_) {
+        endEditSession();
     }
+
     qDebug() << "index: " << index;
     qDebug() << "current_index_: " << current_index_;
 
     if (index != -1 && current_index_ != -1 && index != current_index_) {
+        int direction = (index < current_index_) ? -1 : 1;
         loadSonarImage(index);
         loadAnnotations(index);
+        frame_prefetcher_.schedule(index, direction, displayMode());
+    }
+
+    if (index != -1) {
+        showSampleTime(index);
     }
 
-    if (!isTopLevelItem && !current->data(0, Qt::UserRole).isNull()) {
-        current_annotation_name_ = current->data(0, Qt::UserRole).toString();
+    QString annotation_name = sample_tree_model_.annotationName(current);
+    if (!annotation_name.isEmpty()) {
+        current_annotation_name_ = annotation_name;
         qDebug() << "Selected annotation: " << current_annotation_name_;
-        if (annotations_[current_index_].contains(current_annotation_name_)) {
+        if (annotations_.contains(current_index_, current_annotation_name_.toStdString())) {
             int index = image_picker_tool_->findIndexByUserData(current_annotation_name_);
             qDebug() << "Path index: " << index;
             image_picker_tool_->setSelected(index);
@@ -203,10 +336,22 @@ void AnnotationWindow::currentItemChanged(QTreeWidgetItem *current, QTreeWidgetI
     image_picker_tool_->setSelected(-1);
 }
 
+void AnnotationWindow::closeEvent(QCloseEvent* event) {
+    endEditSession();
+    cancelLoadSonarLog();
+    thread_.wait();
+    compactAnnotationFile();
+    annotation_writer_.flush();
+    QMainWindow::closeEvent(event);
+}
+
 bool AnnotationWindow::eventFilter(QObject* obj, QEvent* event) {
 
     if (obj == image_picker_tool_) {
-        if (event->type()==QEvent::KeyPress) {
+        if (event->type() == QEvent::MouseButtonRelease) {
+            endEditSession();
+        }
+        else if (event->type()==QEvent::KeyPress) {
             QKeyEvent* key = static_cast<QKeyEvent*>(event);
             if (processImagePickerToolKeyPress(key)) {
                 return true;
@@ -219,7 +364,7 @@ bool AnnotationWindow::eventFilter(QObject* obj, QEvent* event) {
             }
         }
     }
-    else if (obj == treewidget_) {
+    else if (obj == treeview_) {
         if (event->type() == QEvent::KeyRelease) {
             QKeyEvent* key = static_cast<QKeyEvent*>(event);
             if (processTreeWidgetKeyRelease(key)) {
@@ -242,22 +387,23 @@ bool AnnotationWindow::processImagePickerToolKeyPress(QKeyEvent* event) {
 }
 
 void AnnotationWindow::copyPreviousAnnotation() {
-    if (current_index_ > 0) {
-
-        if (!annotations_[current_index_-1].empty() &&
-            annotations_[current_index_].empty()) {
-
-            QList<QVariant> user_data_list;
-            QList<QList<QPointF> > path_list;
-
-            AnnotationMap::iterator it;
-            for (it = annotations_[current_index_-1].begin();
-                  it != annotations_[current_index_-1].end();
-                  it++) {
-                user_data_list << it.key();
-                path_list << it.value();
-                for (size_t i = 0; i < path_list.size(); i++) {
-                    saveAnnotation(user_data_list[i].toString(), path_list[i]);
+    endEditSession();
+
+    if (current_index_ > 0 && (size_t)current_index_ < sample_store_.size()) {
+
+        if (!annotations_.isEmpty(current_index_-1) &&
+            annotations_.isEmpty(current_index_)) {
+
+            // saving an annotation changes the store, so the polygon count is read up front
+            size_t polygon_count = annotations_.polygonCount(current_index_-1);
+            for (size_t i = 0; i < polygon_count; i++) {
+                AnnotationStore::PolygonView polygon = annotations_.polygon(current_index_-1, i);
+                QString annotation_name = QString::fromStdString(annotations_.label(polygon.label_id));
+
+                // the previous sample may have another geometry
+                std::vector<cv::Point2f> points(polygon.begin(), polygon.end());
+                if (snapToFan(points)) {
+                    saveAnnotation(annotation_name, points);
                 }
             }
             loadAnnotations(current_index_);
@@ -276,6 +422,14 @@ bool AnnotationWindow::processImagePickerToolKeyRelease(QKeyEvent* event) {
             nextSample();
             return true;
         }
+        case Qt::Key_PageUp: {
+            strideSample(-1);
+            return true;
+        }
+        case Qt::Key_PageDown: {
+            strideSample(1);
+            return true;
+        }
         case Qt::Key_Escape: {
             image_picker_tool_->removeLastPoint();
             return true;
@@ -296,6 +450,8 @@ bool AnnotationWindow::processTreeWidgetKeyRelease(QKeyEvent* event) {
             return true;
         }
         case Qt::Key_Delete: {
+            endEditSession();
+
             if (!current_annotation_name_.isEmpty()) {
 
                 QMessageBox::StandardButton reply = QMessageBox::question(this,
@@ -306,7 +462,7 @@ bool AnnotationWindow::processTreeWidgetKeyRelease(QKeyEvent* event) {
                 if (reply == QMessageBox::Yes) {
                     qDebug() << "Delete the annotation: " << current_annotation_name_;
 
-                    if (annotations_[current_index_].contains(current_annotation_name_)) {
+                    if (annotations_.contains(current_index_, current_annotation_name_.toStdString())) {
 
                         int index = image_picker_tool_->findIndexByUserData(current_annotation_name_);
                         qDebug() << "Path Index: " << index;
@@ -314,30 +470,14 @@ bool AnnotationWindow::processTreeWidgetKeyRelease(QKeyEvent* event) {
                         //remove path from image_picker_tool
                         image_picker_tool_->removePath(index);
 
-                        //remove from annotations map
-                        annotations_[current_index_].remove(current_annotation_name_);
-
-                        //write new annotation file
-                        writeAnnotationFile();
-
                         QString annotation_name = current_annotation_name_;
                         current_annotation_name_ = "";
 
-                        //remove from treewidget
-                        for (size_t i = 0; i < annotation_treeitems_[current_index_]->childCount(); i++) {
-                            QTreeWidgetItem *item = annotation_treeitems_[current_index_]->child(index);
-                            if (item->text(0) == annotation_name) {
-                                annotation_treeitems_[current_index_]->removeChild(item);
-                                delete item;
-                                break;
-                            }
-                        }
-
-                        if (annotation_treeitems_[current_index_]->childCount() == 0) {
-                            treeitems_[current_index_]->removeChild(annotation_treeitems_[current_index_]);
-                            delete annotation_treeitems_[current_index_];
-                            annotation_treeitems_[current_index_] = NULL;
-                        }
+                        //remove from annotations map and treeview
+                        sample_tree_model_.removeAnnotation(current_index_, annotation_name);
+
+                        //write new annotation file
+                        persistAnnotationRemoval(current_index_, annotation_name);
                     }
                 }
             }
@@ -348,21 +488,75 @@ bool AnnotationWindow::processTreeWidgetKeyRelease(QKeyEvent* event) {
 
 void AnnotationWindow::previousSample() {
     if ((current_index_-1) >= 0) {
-        treewidget_->setCurrentItem(treeitems_[current_index_-1]);
+        treeview_->setCurrentIndex(sample_tree_model_.sampleIndex(current_index_-1));
     }
 }
 
 void AnnotationWindow::nextSample() {
-    if ((current_index_+1) < treeitems_.size()) {
-        treewidget_->setCurrentItem(treeitems_[current_index_+1]);
+    if ((current_index_+1) < sample_tree_model_.sampleCount()) {
+        treeview_->setCurrentIndex(sample_tree_model_.sampleIndex(current_index_+1));
+    }
+}
+
+void AnnotationWindow::selectSample(int index) {
+    // only the target sample is decoded, the samples skipped over are not
+    QModelIndex sample_index = sample_tree_model_.sampleIndex(index);
+    if (sample_index.isValid() && index != current_index_) {
+        treeview_->setCurrentIndex(sample_index);
+        treeview_->scrollTo(sample_index);
     }
 }
 
+void AnnotationWindow::strideSample(int direction) {
+    if (current_index_ == -1) {
+        return;
+    }
+
+    int stride = stride_spinbox_->value();
+
+    if (stride_unit_combobox_->currentIndex() == kStrideFrames) {
+        int index = qBound(0, current_index_ + direction * stride, sample_tree_model_.sampleCount() - 1);
+        selectSample(index);
+        return;
+    }
+
+    int64_t time = sample_store_.entry(current_index_).time + (int64_t)direction * stride * 1000000;
+    int index = sample_store_.findSample(time, (direction > 0) ? SonarSampleStore::kSeekAtOrAfter : SonarSampleStore::kSeekAtOrBefore);
+
+    // past either end of the log the stride stops at the last sample in that direction
+    if (index == -1) {
+        index = sample_store_.findSample(time);
+    }
+
+    selectSample(index);
+}
+
+void AnnotationWindow::showSampleTime(int index) {
+    jump_time_edit_->setDateTime(QDateTime::fromMSecsSinceEpoch(sample_store_.entry(index).time / 1000));
+}
+
+void AnnotationWindow::jumpToTimeClicked(bool checked) {
+    int64_t time = (int64_t)jump_time_edit_->dateTime().toMSecsSinceEpoch() * 1000;
+    int index = sample_store_.findSample(time);
+
+    if (index != -1) {
+        selectSample(index);
+    }
+}
+
+void AnnotationWindow::strideBackwardClicked(bool checked) {
+    strideSample(-1);
+}
+
+void AnnotationWindow::strideForwardClicked(bool checked) {
+    strideSample(1);
+}
+
 void AnnotationWindow::pathAppended(QList<QPointF>& path, QVariant& user_data) {
     QInputDialog *input_dialog = new QInputDialog(this);
 
     if (current_index_ != -1) {
-        int total_annotations = annotations_[current_index_].size();
+        int total_annotations = annotations_.polygonCount(current_index_);
         QString annotation_name;
 
         if (last_annotation_name_.isEmpty()) {
@@ -381,7 +575,7 @@ void AnnotationWindow::pathAppended(QList<QPointF>& path, QVariant& user_data) {
         }
 
         qDebug() << "annotation_name: " << annotation_name;
-        if (annotations_[current_index_].contains(annotation_name)){
+        if (annotations_.contains(current_index_, annotation_name.toStdString())){
             QString message = QString("It already exist an annotation with name: %1").arg(annotation_name);
             QMessageBox messagebox(QMessageBox::Information, "Annotation name is invalid ", message);
             messagebox.exec();
@@ -389,7 +583,18 @@ void AnnotationWindow::pathAppended(QList<QPointF>& path, QVariant& user_data) {
             return;
         }
 
-        saveAnnotation(annotation_name, path);
+        std::vector<cv::Point2f> points = toCvPoints(path);
+        if (!snapToFan(points)) {
+            image_picker_tool_->removeLastPath();
+            return;
+        }
+
+        // the tool shows the snapped path
+        for (int i = 0; i < path.size(); i++) {
+            path[i] = QPointF(points[i].x, points[i].y);
+        }
+
+        saveAnnotation(annotation_name, points);
         last_annotation_name_ = annotation_name;
         user_data = annotation_name;
     }
@@ -397,128 +602,101 @@ void AnnotationWindow::pathAppended(QList<QPointF>& path, QVariant& user_data) {
 
 void AnnotationWindow::pointChanged(const QList<QPointF>& path, const QVariant& user_data, QBool& ignore) {
 
+    const RemapTablePtr& remap_table = frame_renderer_.remap_table();
+
+    if (!remap_table) {
+        ignore = QBool(true);
+        return;
+    }
+
     for (int i = 0; i < path.size(); i++) {
-        if (sonar_holder_.cart_to_polar_index(path.at(i).x(), path.at(i).y()) == -1) {
+        if (!remap_table->is_valid(path.at(i).x(), path.at(i).y())) {
             ignore = QBool(true);
             return;
         }
     }
 
-    updateAnnotation(user_data.toString(), path);
-}
+    QString annotation_name = user_data.toString();
 
-void AnnotationWindow::pointAppened(const QPointF& point, QBool& ignore) {
-    ignore = QBool((sonar_holder_.cart_to_polar_index((int)point.x(), (int)point.y()) == -1));
-}
-
-void AnnotationWindow::saveAnnotation(QString annotation_name, const QList<QPointF>& points) {
-    annotations_[current_index_].insert(annotation_name, points);
-    addAnnotationTreeItem(current_index_, annotation_name, points);
-    writeAnnotationFile();
-}
+    if (edit_sample_index_ != current_index_ || edit_annotation_name_ != annotation_name) {
+        endEditSession();
+        edit_sample_index_ = current_index_;
+        edit_annotation_name_ = annotation_name;
+    }
 
-void AnnotationWindow::addAnnotationTreeItem(int index, const QString& annotation_name, const QList<QPointF>& points) {
+    edit_points_ = toCvPoints(path);
+    edit_pending_ = true;
 
-    if (!annotation_treeitems_[index]) {
-        QTreeWidgetItem *item = createItem("Annotations", "", treeitems_[index]);
-        annotation_treeitems_[index] = item;
-        treeitems_[index]->addChild(item);
+    if (!edit_flush_timer_.isActive()) {
+        edit_flush_timer_.start();
     }
-
-    QTreeWidgetItem* annotation_item = createAnnotationItem(annotation_name, points);
-    annotation_item->setData(0, Qt::UserRole, annotation_name);
-    annotation_item->setData(1, Qt::UserRole, index);
-    annotation_treeitems_[index]->addChild(annotation_item);
+    edit_session_timer_.start();
 }
 
-void AnnotationWindow::loadAnnotationTreeItems(const QList<AnnotationMap>& annotations) {
-    for (size_t sample_index = 0; sample_index < annotations.size(); sample_index++) {
-        AnnotationMap::const_iterator it = annotations[sample_index].begin();
-        while (it != annotations[sample_index].end()) {
-            addAnnotationTreeItem(sample_index, it.key(), it.value());
-            it++;
-        }
+void AnnotationWindow::flushEdit() {
+    if (edit_pending_ && edit_sample_index_ != -1) {
+        ScopedTimer timer("window.update_annotation");
+        sample_tree_model_.updateAnnotation(edit_sample_index_, edit_annotation_name_, edit_points_);
     }
+    edit_pending_ = false;
 }
 
-void AnnotationWindow::updateAnnotation(QString annotation_name, const QList<QPointF>& points) {
-    if (annotations_[current_index_].contains(annotation_name)) {
-        annotations_[current_index_].insert(annotation_name, points);
-
-        writeAnnotationFile();
-
-        for (size_t index = 0; index < annotation_treeitems_[current_index_]->childCount(); index++) {
-            QTreeWidgetItem *item = annotation_treeitems_[current_index_]->child(index);
-            if (item->text(0) == annotation_name) {
-                qDebug() << "The annotation is: " << annotation_name;
-
-                if (item->childCount() != points.size()) {
-                    qDebug() << "Point and Child don't have the same time";
-                    return;
-                }
-
-                QString point_string_list;
-                for (size_t idx = 0; idx < item->childCount() && idx < points.size(); idx++) {
-                    QString point_string = QString("(%1,%2)").
-                                               arg(points[idx].x()).
-                                               arg(points[idx].y());
-
-                    QTreeWidgetItem *child = item->child(idx);
-                    child->setText(0, QString("%1").arg(idx));
-                    child->setText(1, point_string);
+void AnnotationWindow::endEditSession() {
+    if (edit_sample_index_ == -1) {
+        return;
+    }
 
-                    point_string_list += point_string;
+    edit_flush_timer_.stop();
+    edit_session_timer_.stop();
+    flushEdit();
 
-                    if (idx < points.size()-1) {
-                        point_string_list += ", ";
-                    }
-                }
+    if (annotations_.contains(edit_sample_index_, edit_annotation_name_.toStdString())) {
+        persistAnnotation(edit_sample_index_, edit_annotation_name_);
+    }
 
-                item->setText(1, point_string_list);
+    edit_sample_index_ = -1;
+    edit_annotation_name_.clear();
+    edit_points_.clear();
+}
 
-                return;
-            }
-        }
-    }
+void AnnotationWindow::pointAppened(const QPointF& point, QBool& ignore) {
+    ignore = QBool((frame_renderer_.cart_to_polar_index((int)point.x(), (int)point.y()) == -1));
 }
 
-QTreeWidgetItem* AnnotationWindow::createAnnotationItem(const QString& name, const QList<QPointF>& points) {
+bool AnnotationWindow::snapToFan(std::vector<cv::Point2f>& points) {
+    const RemapTablePtr& remap_table = frame_renderer_.remap_table();
 
-    QList<QTreeWidgetItem*> point_items;
-    QString point_string_list;
+    if (!remap_table) {
+        return false;
+    }
 
     for (size_t i = 0; i < points.size(); i++) {
-        QString point_string = QString("(%1,%2)").arg(points[i].x()).arg(points[i].y());
-        QStringList data;
-        data << QString("%1").arg(i) << point_string;
-        point_items << new QTreeWidgetItem(data);
-        point_string_list += point_string;
-        if (i < points.size()-1) {
-            point_string_list += ", ";
+        if (!remap_table->snap_to_valid(points[i].x, points[i].y, kMaxSnapDistance)) {
+            return false;
         }
     }
 
-    QStringList data;
-    data << name << point_string_list;
-    QTreeWidgetItem *item = new QTreeWidgetItem(data);
-    item->addChildren(point_items);
-    return item;
+    return true;
+}
+
+void AnnotationWindow::saveAnnotation(QString annotation_name, const std::vector<cv::Point2f>& points) {
+    ScopedTimer timer("window.save_annotation");
+    sample_tree_model_.insertAnnotation(current_index_, annotation_name, points);
+    persistAnnotation(current_index_, annotation_name);
 }
 
 void AnnotationWindow::loadAnnotations(int index) {
     image_picker_tool_->clearPaths();
     image_picker_tool_->setSelected(-1);
 
-    if (!annotations_[index].isEmpty()) {
-        AnnotationMap::iterator it;
+    if (!annotations_.isEmpty(index)) {
         QList<QVariant> user_data_list;
         QList<QList<QPointF> > path_list;
 
-        for (it = annotations_[index].begin();
-              it != annotations_[index].end();
-              it++) {
-            user_data_list << it.key();
-            path_list << it.value();
+        for (size_t i = 0; i < annotations_.polygonCount(index); i++) {
+            AnnotationStore::PolygonView polygon = annotations_.polygon(index, i);
+            user_data_list << QString::fromStdString(annotations_.label(polygon.label_id));
+            path_list << toQtPoints(polygon);
         }
         image_picker_tool_->appendPaths(path_list, user_data_list);
     }
@@ -529,26 +707,43 @@ void AnnotationWindow::releaseAnnotations() {
 }
 
 void AnnotationWindow::releaseTreeItems() {
-    treewidget_->clear();
-    treeitems_.clear();
-    annotation_treeitems_.clear();
+    sample_tree_model_.reset(0);
 }
 
 void AnnotationWindow::openLogFileClicked(bool checked) {
     logfilepath_ = QFileDialog::getOpenFileName(this, "Open Sonar Log File", "", "PocoLog (*.log)");
 
     if (!logfilepath_.isEmpty()) {
+        endEditSession();
+        cancelLoadSonarLog();
+        thread_.wait();
+
+        compactAnnotationFile();
+        annotation_writer_.close();
+
         setWindowTitle(QString("%1-%2").arg(APP_NAME).arg(logfilepath_));
         annotation_filepath_ = generateAnnotationFilePath(logfilepath_);
+        index_filepath_ = generateIndexFilePath(logfilepath_);
+
+        frame_prefetcher_.cancel();
+        frame_prefetcher_.waitForDone();
 
         current_index_ = -1;
-        samples_.clear();
+        renderer_sample_index_ = -1;
+        sample_store_.close();
+        frame_cache_.clear();
         releaseAnnotations();
         releaseTreeItems();
 
+        delete load_sonarlog_progress_;
+
+        // the samples can be browsed and annotated while the log is read
         QString message = QString("Loading log file:\n%1").arg(logfilepath_);
-        load_sonarlog_progress_ = new QProgressDialog(message, NULL, 0, 0, this);
-        load_sonarlog_progress_->setWindowModality(Qt::WindowModal);
+        load_sonarlog_progress_ = new QProgressDialog(message, "Cancel", 0, 100, this);
+        load_sonarlog_progress_->setWindowModality(Qt::NonModal);
+        load_sonarlog_progress_->setAutoClose(false);
+        load_sonarlog_progress_->setAutoReset(false);
+        connect(load_sonarlog_progress_, SIGNAL(canceled()), this, SLOT(cancelLoadSonarLog()));
         load_sonarlog_progress_->show();
 
         load_sonarlog_worker_.requestLoadSonarLog();
@@ -557,25 +752,147 @@ void AnnotationWindow::openLogFileClicked(bool checked) {
 
 void AnnotationWindow::enableEnhancementStateChanged(int state) {
     loadSonarImage(current_index_, true);
+    frame_prefetcher_.schedule(current_index_, 1, displayMode());
 }
 
 void AnnotationWindow::enablePreprocessingStateChanged(int state) {
     loadSonarImage(current_index_, true);
+    frame_prefetcher_.schedule(current_index_, 1, displayMode());
+}
+
+void AnnotationWindow::paletteChanged(int index) {
+    applyPalette();
+}
+
+void AnnotationWindow::gammaChanged(double gamma) {
+    applyPalette();
+}
+
+void AnnotationWindow::enableProfilingStateChanged(int state) {
+    bool enabled = (state == Qt::Checked);
+    Profiler::setEnabled(enabled);
+    profiler_label_->setVisible(enabled);
+
+    if (enabled) {
+        profiler_timer_.start();
+        updateProfilerOverlay();
+    }
+    else {
+        profiler_timer_.stop();
+    }
+}
+
+void AnnotationWindow::exportTraceClicked(bool checked) {
+    QString filepath = QFileDialog::getSaveFileName(this, "Export Trace", "sonarlog_annotation_trace.json", "Chrome Trace (*.json)");
+
+    if (!filepath.isEmpty() && !Profiler::instance().writeChromeTrace(filepath.toStdString())) {
+        QMessageBox::warning(this, "Export Trace", QString("Could not write the trace file: %1").arg(filepath));
+    }
+}
+
+void AnnotationWindow::updateProfilerOverlay() {
+    std::vector<Profiler::StageStatistics> statistics = Profiler::instance().statistics();
+
+    // the stages that took the most time overall come first
+    QMultiMap<int64_t, QString> stages;
+    for (size_t i = 0; i < statistics.size(); i++) {
+        const Profiler::StageStatistics& stage = statistics[i];
+        stages.insert(-stage.total_us, QString("%1 %2/%3 ms")
+                                           .arg(QString::fromStdString(stage.name))
+                                           .arg(stage.mean_us() / 1000.0, 0, 'f', 1)
+                                           .arg(stage.percentile_us(90) / 1000.0, 0, 'f', 1));
+    }
+
+    QStringList lines;
+    QMultiMap<int64_t, QString>::const_iterator it;
+    for (it = stages.constBegin(); it != stages.constEnd() && lines.size() < kProfilerOverlayStages; it++) {
+        lines << it.value();
+    }
+
+    const FrameCache::Statistics& cache = frame_cache_.statistics();
+    QString cache_text = QString("cache %1/%2 hits %3 frames %4 MB")
+                             .arg(cache.hits)
+                             .arg(cache.hits + cache.misses)
+                             .arg(cache.frames)
+                             .arg(cache.bytes / (1024.0 * 1024.0), 0, 'f', 1);
+
+    QString stages_text = (lines.isEmpty()) ? QString("profiling: no samples") : "mean/p90 " + lines.join(" | ");
+    profiler_label_->setText(stages_text + " | " + cache_text);
+}
+
+void AnnotationWindow::applyPalette() {
+    DisplayPalette palette = (DisplayPalette)palette_combobox_->currentIndex();
+    double gamma = gamma_spinbox_->value();
+
+    frame_renderer_.setPalette(palette);
+    frame_renderer_.setGamma(gamma);
+    frame_prefetcher_.setPalette(palette, gamma);
+
+    // the cached frames were colored with the previous palette
+    frame_cache_.clear();
+
+    loadSonarImage(current_index_, true);
+    frame_prefetcher_.schedule(current_index_, 1, displayMode());
 }
 
 void AnnotationWindow::loadSonarLog() {
-    current_index_ = -1;
-    loadSamples(logfilepath_, samples_);
+    loadSamples(logfilepath_);
     readAnnotationFile();
-    loadSonarImage(0);
-    loadAnnotations(0);
+    openAnnotationJournal();
+    load_sonarlog_worker_.reportSamplesLoaded(sample_store_.size(), sample_store_.totalSamples());
+
+    while (!sample_store_.indexComplete() && !load_sonarlog_worker_.isCanceled()) {
+        sample_store_.indexBatch(kLoadBatchSize);
+        load_sonarlog_worker_.reportSamplesLoaded(sample_store_.size(), sample_store_.totalSamples());
+    }
 }
 
-void AnnotationWindow::loadLogFileFinished() {
-    loadTreeItems(samples_);
-    load_sonarlog_progress_->hide();
-    delete load_sonarlog_progress_;
-    load_sonarlog_progress_ = NULL;
+void AnnotationWindow::samplesLoaded(int generation, int sample_count, int total_samples) {
+    if (!load_sonarlog_worker_.isCurrent(generation)) {
+        return;
+    }
+
+    sample_tree_model_.appendSamples(sample_count);
+
+    // show the first frame as soon as it is indexed
+    if (current_index_ == -1 && sample_count > 0) {
+        loadSonarImage(0);
+        loadAnnotations(0);
+        treeview_->setCurrentIndex(sample_tree_model_.sampleIndex(0));
+        frame_prefetcher_.schedule(current_index_, 1, displayMode());
+    }
+
+    if (load_sonarlog_progress_) {
+        load_sonarlog_progress_->setValue((total_samples > 0) ? (int)((qint64)sample_count * 100 / total_samples) : 100);
+    }
+}
+
+void AnnotationWindow::cancelLoadSonarLog() {
+    load_sonarlog_worker_.cancel();
+}
+
+void AnnotationWindow::loadLogFileFinished(int generation) {
+    if (!load_sonarlog_worker_.isCurrent(generation)) {
+        return;
+    }
+
+    if (load_sonarlog_worker_.isCanceled()) {
+        qDebug() << "Loading canceled after " << sample_store_.size() << " of " << sample_store_.totalSamples() << " samples";
+    }
+
+    if (load_sonarlog_progress_) {
+        load_sonarlog_progress_->hide();
+        load_sonarlog_progress_->deleteLater();
+        load_sonarlog_progress_ = NULL;
+    }
+}
+
+void AnnotationWindow::loadLogFileFailed(int generation, const QString& error) {
+    if (!load_sonarlog_worker_.isCurrent(generation)) {
+        return;
+    }
+
+    QMessageBox::warning(this, "Open Sonar Log", QString("Could not load %1: %2").arg(logfilepath_).arg(error));
 }
 
 QString AnnotationWindow::generateAnnotationFilePath(const QString& logfilepath) {
@@ -583,61 +900,91 @@ QString AnnotationWindow::generateAnnotationFilePath(const QString& logfilepath)
     return file_info.absolutePath() + "/" +  file_info.completeBaseName() + "_annotation.yml";
 }
 
+QString AnnotationWindow::generateIndexFilePath(const QString& logfilepath) {
+    QFileInfo file_info(logfilepath);
+    return file_info.absolutePath() + "/" +  file_info.completeBaseName() + "_" + stream_name_ + ".idx";
+}
+
 void AnnotationWindow::readAnnotationFile() {
     QFileInfo info(annotation_filepath_);
+    QFileInfo journal_info(QString::fromStdString(AnnotationJournal::journalFilePath(annotation_filepath_.toStdString())));
 
-    if (info.exists() && info.isFile()) {
+    if ((info.exists() && info.isFile()) || journal_info.exists()) {
         AnnotationFileReader reader(annotation_filepath_.toStdString());
-        std::vector<AnnotationFileReader::AnnotationMap> samples_annotations = reader.read();
+        reader.read(annotations_);
 
-        for (size_t sample_idx = 0; sample_idx < samples_annotations.size(); sample_idx++) {
-            AnnotationFileReader::AnnotationMap annotations = samples_annotations[sample_idx];
-            AnnotationFileReader::AnnotationMap::iterator annotation_it = annotations.begin();
+        // the annotations past the end of the log are dropped
+        annotations_.resize(sample_store_.totalSamples());
+    }
+}
 
-            while (annotation_it != annotations.end()) {
-                QString annotation_name = QString::fromStdString(annotation_it->first);
-                QList<QPointF> points = toQtPoints(annotation_it->second);
-                annotations_[sample_idx].insert(annotation_name, points);
-                annotation_it++;
-            }
-        }
+void AnnotationWindow::persistAnnotation(int index, const QString& annotation_name) {
+    // without a journal (e.g. a read-only directory) the snapshot is rewritten
+    if (!annotation_writer_.isJournalOpen()) {
+        annotation_writer_.markDirty(index);
+        annotation_writer_.scheduleWrite(annotations_);
+        return;
+    }
+
+    std::string name = annotation_name.toStdString();
+    int position = annotations_.findPolygon(index, name);
+
+    // the annotation is gone, its removal was journaled already
+    if (position == -1) {
+        return;
+    }
+
+    annotation_writer_.appendSet(index, name, annotations_.polygon(index, position));
 
+    if (annotation_writer_.journalRecordCount() >= kJournalCompactionThreshold) {
+        compactAnnotationFile();
     }
 }
 
-void AnnotationWindow::writeAnnotationFile() {
-    cv::FileStorage file_storage(annotation_filepath_.toStdString(), cv::FileStorage::WRITE | cv::FileStorage::FORMAT_YAML);
+void AnnotationWindow::persistAnnotationRemoval(int index, const QString& annotation_name) {
+    if (!annotation_writer_.isJournalOpen()) {
+        annotation_writer_.markDirty(index);
+        annotation_writer_.scheduleWrite(annotations_);
+        return;
+    }
 
-    int sample_number = 0;
-    for (int sample_number = 0; sample_number < annotations_.count(); sample_number++) {
-        file_storage << QString("sample_%1").arg(sample_number).toStdString();
-        file_storage << "{";
-        if (!annotations_[sample_number].isEmpty()) {
-            AnnotationMap::iterator it;
-            for (it = annotations_[sample_number].begin(); it != annotations_[sample_number].end(); it++) {
-                file_storage << it.key().toStdString() << cv::Mat(toCvPoints(it.value()));
-            }
-        }
-        file_storage << "}";
+    annotation_writer_.appendRemove(index, annotation_name.toStdString());
+
+    if (annotation_writer_.journalRecordCount() >= kJournalCompactionThreshold) {
+        compactAnnotationFile();
     }
-    file_storage.release();
 }
 
-std::vector<cv::Point2f> AnnotationWindow::toCvPoints(const QList<QPointF>& points) {
-    std::vector<cv::Point2f> cv_points(points.count());
-    for (size_t i = 0; i < points.count(); i++) {
-        cv_points[i] = cv::Point2f(points[i].x(), points[i].y());
+void AnnotationWindow::openAnnotationJournal() {
+    annotation_writer_.open(annotation_filepath_, true);
+
+    // fold the edits left by a previous session into the annotation file
+    if (annotation_writer_.journalRecordCount() > 0) {
+        compactAnnotationFile();
+    }
+}
+
+void AnnotationWindow::compactAnnotationFile() {
+    if (annotation_writer_.isJournalOpen() && annotation_writer_.journalRecordCount() > 0) {
+        annotation_writer_.compact(annotations_);
     }
-    return cv_points;
 }
 
-QList<QPointF> AnnotationWindow::toQtPoints(const std::vector<cv::Point2f>& points) {
+QList<QPointF> AnnotationWindow::toQtPoints(const AnnotationStore::PolygonView& points) {
     QList<QPointF> qpoints;
-    for (size_t i = 0; i < points.size(); i++) {
-        qpoints.append(QPointF(points[i].x, points[i].y));
+    qpoints.reserve(points.size);
+    for (size_t i = 0; i < points.size; i++) {
+        qpoints.append(QPointF(points.points[i].x, points.points[i].y));
     }
     return qpoints;
+}
 
+std::vector<cv::Point2f> AnnotationWindow::toCvPoints(const QList<QPointF>& points) {
+    std::vector<cv::Point2f> cvpoints(points.size());
+    for (int i = 0; i < points.size(); i++) {
+        cvpoints[i] = cv::Point2f(points[i].x(), points[i].y());
+    }
+    return cvpoints;
 }
 
 
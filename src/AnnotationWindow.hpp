@@ -4,8 +4,13 @@
 #include <iostream>
 #include <QtGui>
 #include <base/samples/Sonar.hpp>
-#include <sonar_processing/SonarHolder.hpp>
 #include <image_picker_tool/ImagePickerTool.hpp>
+#include "AnnotationWriter.hpp"
+#include "FrameCache.hpp"
+#include "FramePrefetcher.hpp"
+#include "FrameRenderer.hpp"
+#include "SampleTreeModel.hpp"
+#include "SonarSampleStore.hpp"
 
 #define APP_NAME "Sonarlog Annotation Tool"
 
@@ -18,19 +23,44 @@ class LoadSonarLogWorker : public QObject {
     Q_OBJECT
 public:
     LoadSonarLogWorker(AnnotationWindow* annotation_window)
-        : annotation_window_(annotation_window) {
+        : annotation_window_(annotation_window)
+        , generation_(0)
+        , running_generation_(0)
+        , canceled_(0) {
     }
 
     virtual ~LoadSonarLogWorker() {
     }
 
     void requestLoadSonarLog() {
+        generation_.ref();
+        canceled_ = 0;
         emit loadSonarLogRequested();
     }
 
+    // ask the running load to stop after the current batch
+    void cancel() {
+        canceled_ = 1;
+    }
+
+    bool isCanceled() const {
+        return canceled_ != 0;
+    }
+
+    // signals of a previous load may still be queued when a new one starts
+    bool isCurrent(int generation) const {
+        return generation == (int)generation_;
+    }
+
+    void reportSamplesLoaded(int sample_count, int total_samples) {
+        emit samplesLoaded(running_generation_, sample_count, total_samples);
+    }
+
 signals:
     void loadSonarLogRequested();
-    void finished();
+    void samplesLoaded(int generation, int sample_count, int total_samples);
+    void loadFailed(int generation, const QString& error);
+    void finished(int generation);
 
 public slots:
     void performLoadSonarLog();
@@ -38,6 +68,9 @@ public slots:
 private:
 
     AnnotationWindow* annotation_window_;
+    QAtomicInt generation_;
+    int running_generation_;
+    QAtomicInt canceled_;
 };
 
 
@@ -52,78 +85,119 @@ public:
         stream_name_ = s;
     }
 
+    void setFrameCacheCapacity(size_t capacity) {
+        frame_cache_.setCapacity(capacity);
+    }
+
 protected:
     bool eventFilter(QObject* obj, QEvent* event);
+    void closeEvent(QCloseEvent* event);
 
 protected slots:
-    void currentItemChanged(QTreeWidgetItem * current, QTreeWidgetItem * previous);
+    void currentIndexChanged(const QModelIndex& current, const QModelIndex& previous);
     void pathAppended(QList<QPointF>& path, QVariant& user_data);
     void pointChanged(const QList<QPointF>& path, const QVariant& user_data, QBool& ignore);
     void pointAppened(const QPointF& point, QBool& ignore);
     void openLogFileClicked(bool checked);
     void enableEnhancementStateChanged(int state);
     void enablePreprocessingStateChanged(int state);
-    void loadLogFileFinished();
+    void paletteChanged(int index);
+    void gammaChanged(double gamma);
+    void flushEdit();
+    void enableProfilingStateChanged(int state);
+    void exportTraceClicked(bool checked);
+    void updateProfilerOverlay();
+    void jumpToTimeClicked(bool checked);
+    void strideBackwardClicked(bool checked);
+    void strideForwardClicked(bool checked);
+    void endEditSession();
+    void loadLogFileFinished(int generation);
+    void loadLogFileFailed(int generation, const QString& error);
+    void samplesLoaded(int generation, int sample_count, int total_samples);
+    void cancelLoadSonarLog();
+    void prefetchedFrameReady(int sample_index, int mode, const cv::Mat& frame);
 
 signals:
     void performLoadSonarLogFile();
 
 private:
 
-    typedef QMap<QString, QList<QPointF> > AnnotationMap;
-
     void setupLoadSonarLogWorker();
+    void setupFramePrefetcher();
     void setupImagePickerTool();
     void setupRightDockWidget();
     void setupTreeView();
+    void setupEditTimers();
+    void setupProfilerOverlay();
 
-    void loadSamples(const QString& logfilepath, QList<base::samples::Sonar>& samples);
+    void loadSamples(const QString& logfilepath);
     void loadSonarImage(int sample_number, bool redraw = false);
-    void loadTreeItems(const QList<base::samples::Sonar>& samples);
-    void loadAnnotationTreeItems(const QList<AnnotationMap>& annotations);
+    void resetFrameRenderer(int sample_number);
+    bool rendererGeometryMatches(int sample_number);
+    DisplayMode displayMode() const;
+    void applyPalette();
     void loadAnnotations(int index);
 
     void previousSample();
     void nextSample();
+    void selectSample(int index);
 
-    QTreeWidgetItem* createSampleTreeItem(const base::samples::Sonar& sample, QTreeWidgetItem* parent = NULL);
-    QTreeWidgetItem* createItem(const QString& name, const QString& value, QTreeWidgetItem* parent = NULL);
+    // move by the stride of the dock, in frames or in seconds
+    void strideSample(int direction);
+    void showSampleTime(int index);
 
     bool processImagePickerToolKeyPress(QKeyEvent* event);
     bool processImagePickerToolKeyRelease(QKeyEvent* event);
     bool processTreeWidgetKeyRelease(QKeyEvent* event);
 
-    void saveAnnotation(QString annotation_name, const QList<QPointF>& points);
-    void updateAnnotation(QString annotation_name, const QList<QPointF>& points);
-    void addAnnotationTreeItem(int index, const QString& annotation_name, const QList<QPointF>& points);
+    void saveAnnotation(QString annotation_name, const std::vector<cv::Point2f>& points);
 
     void copyPreviousAnnotation();
+    bool snapToFan(std::vector<cv::Point2f>& points);
 
     void releaseAnnotations();
     void releaseTreeItems();
 
     void readAnnotationFile();
-    void writeAnnotationFile();
+
+    void persistAnnotation(int index, const QString& annotation_name);
+    void persistAnnotationRemoval(int index, const QString& annotation_name);
+    void openAnnotationJournal();
+    void compactAnnotationFile();
 
     QString generateAnnotationFilePath(const QString& logfilepath);
+    QString generateIndexFilePath(const QString& logfilepath);
 
+    // the image picker tool works on Qt points, the annotations are kept as OpenCV points
+    QList<QPointF> toQtPoints(const AnnotationStore::PolygonView& points);
     std::vector<cv::Point2f> toCvPoints(const QList<QPointF>& points);
-    QList<QPointF> toQtPoints(const std::vector<cv::Point2f>& points);
-
 
-    QTreeWidgetItem* createAnnotationItem(const QString& name, const QList<QPointF>& points);
     QPushButton *open_logfile_button_;
     QCheckBox *enable_enhancement_button_;
     QCheckBox *enable_preprocessing_button_;
-    QTreeWidget *treewidget_;
+    QComboBox *palette_combobox_;
+    QDoubleSpinBox *gamma_spinbox_;
+    QCheckBox *enable_profiling_button_;
+    QPushButton *export_trace_button_;
+    QLabel *profiler_label_;
+    QTimer profiler_timer_;
+    QDateTimeEdit *jump_time_edit_;
+    QPushButton *jump_time_button_;
+    QSpinBox *stride_spinbox_;
+    QComboBox *stride_unit_combobox_;
+    QPushButton *stride_backward_button_;
+    QPushButton *stride_forward_button_;
+    QTreeView *treeview_;
     image_picker_tool::ImagePickerTool* image_picker_tool_;
 
 
-    QList<base::samples::Sonar> samples_;
-    QList<AnnotationMap> annotations_;
-    QList<QTreeWidgetItem*> treeitems_;
-    QList<QTreeWidgetItem*> annotation_treeitems_;
-    sonar_processing::SonarHolder sonar_holder_;
+    SonarSampleStore sample_store_;
+    AnnotationStore annotations_;
+    SampleTreeModel sample_tree_model_;
+    FrameRenderer frame_renderer_;
+    int renderer_sample_index_;
+    FrameCache frame_cache_;
+    FramePrefetcher frame_prefetcher_;
 
     QProgressDialog *load_sonarlog_progress_;
 
@@ -136,8 +210,19 @@ private:
     LoadSonarLogWorker load_sonarlog_worker_;
 
     QString annotation_filepath_;
+    AnnotationWriter annotation_writer_;
+    QString index_filepath_;
     QString last_annotation_name_;
     QString stream_name_;
+
+    // vertex drag being edited, applied to the model at most once per frame
+    // and persisted when the drag ends
+    int edit_sample_index_;
+    QString edit_annotation_name_;
+    std::vector<cv::Point2f> edit_points_;
+    bool edit_pending_;
+    QTimer edit_flush_timer_;
+    QTimer edit_session_timer_;
 };
 
 } /* namespace sonarlog_annotation */
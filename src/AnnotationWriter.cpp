@@ -0,0 +1,356 @@
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+#include "AnnotationWriter.hpp"
+#include "Profiler.hpp"
+
+namespace sonarlog_annotation {
+
+AnnotationWriter::AnnotationWriter(int debounce_ms, int max_delay_ms)
+    : journal_open_(false)
+    , journal_record_count_(0)
+    , sequence_(0)
+    , snapshot_pending_(false)
+    , snapshot_compact_(false)
+    , snapshot_sequence_(0)
+    , rebuild_chunks_(true)
+    , debounce_ms_(debounce_ms)
+    , max_delay_ms_(max_delay_ms)
+    , busy_(false)
+    , flush_requested_(false)
+    , stop_(false)
+{
+    start();
+}
+
+AnnotationWriter::~AnnotationWriter() {
+    {
+        QMutexLocker locker(&mutex_);
+        stop_ = true;
+        work_condition_.wakeAll();
+    }
+    wait();
+    journal_.close();
+}
+
+void AnnotationWriter::open(const QString& annotation_filepath, bool journal_enabled) {
+    close();
+
+    QMutexLocker locker(&mutex_);
+    annotation_filepath_ = annotation_filepath;
+    rebuild_chunks_ = true;
+
+    if (journal_enabled) {
+        journal_.open(annotation_filepath.toStdString());
+        journal_open_ = journal_.isOpen();
+        journal_record_count_ = journal_.recordCount();
+    }
+}
+
+void AnnotationWriter::close() {
+    flush();
+
+    QMutexLocker locker(&mutex_);
+    journal_.close();
+    journal_open_ = false;
+    journal_record_count_ = 0;
+    annotation_filepath_.clear();
+    dirty_samples_.clear();
+    rebuild_chunks_ = true;
+}
+
+void AnnotationWriter::appendSet(int sample_index, const std::string& name, const AnnotationStore::PolygonView& polygon) {
+    JournalRecord record;
+    record.remove = false;
+    record.sample_index = sample_index;
+    record.name = name;
+    record.points.assign(polygon.begin(), polygon.end());
+    enqueue(record);
+}
+
+void AnnotationWriter::appendRemove(int sample_index, const std::string& name) {
+    JournalRecord record;
+    record.remove = true;
+    record.sample_index = sample_index;
+    record.name = name;
+    enqueue(record);
+}
+
+void AnnotationWriter::markDirty(int sample_index) {
+    QMutexLocker locker(&mutex_);
+    dirty_samples_.insert(sample_index);
+}
+
+void AnnotationWriter::scheduleWrite(const Snapshot& snapshot) {
+    scheduleSnapshot(snapshot, false);
+}
+
+void AnnotationWriter::compact(const Snapshot& snapshot) {
+    scheduleSnapshot(snapshot, true);
+}
+
+void AnnotationWriter::flush() {
+    QMutexLocker locker(&mutex_);
+    flush_requested_ = true;
+    work_condition_.wakeAll();
+
+    while (hasWork() || busy_) {
+        done_condition_.wait(&mutex_);
+    }
+
+    flush_requested_ = false;
+}
+
+bool AnnotationWriter::isJournalOpen() {
+    QMutexLocker locker(&mutex_);
+    return journal_open_;
+}
+
+size_t AnnotationWriter::journalRecordCount() {
+    QMutexLocker locker(&mutex_);
+    return journal_record_count_;
+}
+
+bool AnnotationWriter::writeAnnotationFile(const QString& annotation_filepath, const Snapshot& snapshot) {
+    if (annotation_filepath.isEmpty()) {
+        return false;
+    }
+
+    ScopedTimer timer("annotation.write_snapshot");
+
+    QMap<int, std::string> chunks;
+    for (size_t sample_number = 0; sample_number < snapshot.sampleCount(); sample_number++) {
+        if (!snapshot.isEmpty(sample_number)) {
+            chunks.insert(sample_number, serializeSample(sample_number, snapshot));
+        }
+    }
+
+    return writeChunks(annotation_filepath, chunks);
+}
+
+void AnnotationWriter::run() {
+    QMutexLocker locker(&mutex_);
+
+    while (true) {
+        while (!stop_ && !hasWork()) {
+            work_condition_.wait(&mutex_);
+        }
+
+        if (stop_ && !hasWork()) {
+            break;
+        }
+
+        if (records_.isEmpty() && !snapshotDue()) {
+            int remaining = qMin(debounce_ms_ - (int)last_snapshot_timer_.elapsed(),
+                                 max_delay_ms_ - (int)first_snapshot_timer_.elapsed());
+            work_condition_.wait(&mutex_, qMax(remaining, 1));
+            continue;
+        }
+
+        QList<JournalRecord> records = records_;
+        records_.clear();
+
+        bool write = snapshot_pending_ && snapshotDue();
+        bool compact = false;
+        bool rebuild = false;
+        quint64 snapshot_sequence = 0;
+        Snapshot snapshot;
+        QSet<int> dirty_samples;
+
+        if (write) {
+            snapshot.swap(snapshot_);
+            compact = snapshot_compact_;
+            snapshot_sequence = snapshot_sequence_;
+            dirty_samples.swap(snapshot_dirty_samples_);
+            rebuild = rebuild_chunks_;
+            rebuild_chunks_ = false;
+            snapshot_pending_ = false;
+            snapshot_compact_ = false;
+        }
+
+        QString annotation_filepath = annotation_filepath_;
+        bool compacted = false;
+        busy_ = true;
+        locker.unlock();
+
+        if (write && compact) {
+            // records newer than the snapshot must survive the journal reset
+            QList<JournalRecord> newer_records;
+            QList<JournalRecord> older_records;
+            for (int i = 0; i < records.size(); i++) {
+                if (records[i].sequence > snapshot_sequence) {
+                    newer_records << records[i];
+                }
+                else {
+                    older_records << records[i];
+                }
+            }
+
+            appendRecords(older_records);
+            if (writeSnapshot(annotation_filepath, snapshot, dirty_samples, rebuild)) {
+                journal_.clear();
+                compacted = true;
+            }
+            appendRecords(newer_records);
+        }
+        else {
+            appendRecords(records);
+            if (write) {
+                writeSnapshot(annotation_filepath, snapshot, dirty_samples, rebuild);
+            }
+        }
+
+        locker.relock();
+
+        // only the records past the snapshot are left in the journal
+        if (compacted) {
+            journal_record_count_ = journal_.recordCount() + records_.size();
+        }
+
+        busy_ = false;
+        done_condition_.wakeAll();
+    }
+}
+
+void AnnotationWriter::enqueue(const JournalRecord& record) {
+    QMutexLocker locker(&mutex_);
+    records_ << record;
+    records_.last().sequence = ++sequence_;
+    dirty_samples_.insert(record.sample_index);
+    journal_record_count_++;
+    work_condition_.wakeAll();
+}
+
+void AnnotationWriter::scheduleSnapshot(const Snapshot& snapshot, bool compact) {
+    QMutexLocker locker(&mutex_);
+
+    if (!snapshot_pending_) {
+        first_snapshot_timer_.start();
+    }
+
+    last_snapshot_timer_.start();
+    snapshot_pending_ = true;
+
+    // only the samples the writer serializes are copied: every annotated
+    // sample when the file is rebuilt, otherwise the samples marked dirty
+    if (rebuild_chunks_) {
+        snapshot_.clear();
+        for (size_t sample_number = 0; sample_number < snapshot.sampleCount(); sample_number++) {
+            if (!snapshot.isEmpty(sample_number)) {
+                snapshot_.assignSample(sample_number, snapshot);
+            }
+        }
+    }
+    else {
+        QSet<int>::const_iterator it;
+        for (it = dirty_samples_.constBegin(); it != dirty_samples_.constEnd(); it++) {
+            snapshot_.assignSample(*it, snapshot);
+        }
+    }
+
+    // the samples marked until now are up to date in this snapshot
+    snapshot_dirty_samples_.unite(dirty_samples_);
+    dirty_samples_.clear();
+
+    snapshot_compact_ = snapshot_compact_ || compact;
+    snapshot_sequence_ = sequence_;
+
+    work_condition_.wakeAll();
+}
+
+bool AnnotationWriter::hasWork() const {
+    return !records_.isEmpty() || snapshot_pending_;
+}
+
+bool AnnotationWriter::snapshotDue() const {
+    return flush_requested_ ||
+           stop_ ||
+           snapshot_compact_ ||
+           last_snapshot_timer_.elapsed() >= debounce_ms_ ||
+           first_snapshot_timer_.elapsed() >= max_delay_ms_;
+}
+
+void AnnotationWriter::appendRecords(const QList<JournalRecord>& records) {
+    for (int i = 0; i < records.size(); i++) {
+        if (records[i].remove) {
+            journal_.appendRemove(records[i].sample_index, records[i].name);
+        }
+        else {
+            journal_.appendSet(records[i].sample_index, records[i].name, records[i].points);
+        }
+    }
+}
+
+bool AnnotationWriter::writeSnapshot(const QString& annotation_filepath, const Snapshot& snapshot, const QSet<int>& dirty_samples, bool rebuild) {
+    if (annotation_filepath.isEmpty()) {
+        return false;
+    }
+
+    ScopedTimer timer("annotation.write_snapshot");
+
+    if (rebuild) {
+        chunks_.clear();
+        for (size_t sample_number = 0; sample_number < snapshot.sampleCount(); sample_number++) {
+            if (!snapshot.isEmpty(sample_number)) {
+                chunks_.insert(sample_number, serializeSample(sample_number, snapshot));
+            }
+        }
+    }
+    else {
+        QSet<int>::const_iterator it;
+        for (it = dirty_samples.constBegin(); it != dirty_samples.constEnd(); it++) {
+            if (!snapshot.isEmpty(*it)) {
+                chunks_.insert(*it, serializeSample(*it, snapshot));
+            }
+            else {
+                chunks_.remove(*it);
+            }
+        }
+    }
+
+    return writeChunks(annotation_filepath, chunks_);
+}
+
+std::string AnnotationWriter::serializeSample(int sample_index, const Snapshot& snapshot) {
+    cv::FileStorage file_storage(".yml", cv::FileStorage::WRITE | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_YAML);
+
+    file_storage << AnnotationFileReader::sampleName(sample_index);
+    file_storage << "{";
+    for (size_t i = 0; i < snapshot.polygonCount(sample_index); i++) {
+        // the matrix wraps the points of the store, nothing is copied
+        AnnotationStore::PolygonView polygon = snapshot.polygon(sample_index, i);
+        file_storage << snapshot.label(polygon.label_id) << cv::Mat(polygon.size, 1, CV_32FC2, (void*)polygon.points);
+    }
+    file_storage << "}";
+
+    // drop the document header, the chunks are concatenated under a single one
+    std::string yaml = file_storage.releaseAndGetString();
+    size_t begin = 0;
+    while (begin < yaml.size() && (yaml[begin] == '%' || yaml.compare(begin, 3, "---") == 0)) {
+        size_t end = yaml.find('\n', begin);
+        begin = (end == std::string::npos) ? yaml.size() : end + 1;
+    }
+    return yaml.substr(begin);
+}
+
+bool AnnotationWriter::writeChunks(const QString& annotation_filepath, const QMap<int, std::string>& chunks) {
+    std::string filepath = annotation_filepath.toStdString();
+    std::string temporary_filepath = filepath + ".tmp";
+
+    FILE* file = fopen(temporary_filepath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool success = fputs("%YAML:1.0\n", file) >= 0;
+
+    QMap<int, std::string>::const_iterator it;
+    for (it = chunks.constBegin(); success && it != chunks.constEnd(); it++) {
+        success = fwrite(it.value().data(), 1, it.value().size(), file) == it.value().size();
+    }
+
+    success = (fclose(file) == 0) && success;
+
+    return success && std::rename(temporary_filepath.c_str(), filepath.c_str()) == 0;
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,123 @@
+#ifndef sonarlog_annotation_AnnotationWriter_hpp
+#define sonarlog_annotation_AnnotationWriter_hpp
+
+#include <string>
+#include <QtCore>
+#include "AnnotationJournal.hpp"
+#include "AnnotationStore.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Writes the annotations on a dedicated thread.
+ *
+ * Journal records are appended as they arrive. Snapshots of the whole
+ * annotation state are coalesced: a snapshot is written once no newer one
+ * arrived within the debounce window (or after the maximum delay), the file
+ * is replaced atomically through a temporary file. A compacting snapshot
+ * is written right away and clears the journal afterwards.
+ *
+ * Only the annotated samples are written. The serialized YAML of each
+ * sample is kept between snapshots and only the samples marked dirty since
+ * the previous snapshot are serialized again, so a snapshot costs about
+ * the number of annotated samples, not the length of the log.
+ */
+class AnnotationWriter : public QThread {
+public:
+
+    typedef AnnotationStore Snapshot;
+
+    AnnotationWriter(int debounce_ms = 500, int max_delay_ms = 2000);
+
+    virtual ~AnnotationWriter();
+
+    // flush pending work and switch to another annotation file
+    void open(const QString& annotation_filepath, bool journal_enabled);
+
+    // flush pending work and release the current annotation file
+    void close();
+
+    void appendSet(int sample_index, const std::string& name, const AnnotationStore::PolygonView& polygon);
+
+    void appendRemove(int sample_index, const std::string& name);
+
+    // the sample changed, the next snapshot serializes it again
+    void markDirty(int sample_index);
+
+    // write the snapshot after the debounce window, only the samples marked
+    // dirty are copied (all annotated samples the first time after open)
+    void scheduleWrite(const Snapshot& snapshot);
+
+    // write the snapshot as soon as possible and clear the journal
+    void compact(const Snapshot& snapshot);
+
+    // block until every pending record and snapshot is on disk
+    void flush();
+
+    bool isJournalOpen();
+
+    size_t journalRecordCount();
+
+    static bool writeAnnotationFile(const QString& annotation_filepath, const Snapshot& snapshot);
+
+protected:
+
+    void run();
+
+private:
+
+    struct JournalRecord {
+        bool remove;
+        int sample_index;
+        std::string name;
+        std::vector<cv::Point2f> points;
+        quint64 sequence;
+    };
+
+    void enqueue(const JournalRecord& record);
+    void scheduleSnapshot(const Snapshot& snapshot, bool compact);
+    bool hasWork() const;
+    bool snapshotDue() const;
+    void appendRecords(const QList<JournalRecord>& records);
+    bool writeSnapshot(const QString& annotation_filepath, const Snapshot& snapshot, const QSet<int>& dirty_samples, bool rebuild);
+
+    static std::string serializeSample(int sample_index, const Snapshot& snapshot);
+    static bool writeChunks(const QString& annotation_filepath, const QMap<int, std::string>& chunks);
+
+    QMutex mutex_;
+    QWaitCondition work_condition_;
+    QWaitCondition done_condition_;
+
+    QString annotation_filepath_;
+    AnnotationJournal journal_;
+    bool journal_open_;
+    size_t journal_record_count_;
+
+    QList<JournalRecord> records_;
+    quint64 sequence_;
+
+    // the samples of the pending snapshot, the others are left empty
+    Snapshot snapshot_;
+    QSet<int> dirty_samples_;
+    QSet<int> snapshot_dirty_samples_;
+    bool snapshot_pending_;
+    bool snapshot_compact_;
+    quint64 snapshot_sequence_;
+    QElapsedTimer first_snapshot_timer_;
+    QElapsedTimer last_snapshot_timer_;
+
+    // serialized samples of the written file, only touched by the writer thread
+    QMap<int, std::string> chunks_;
+    bool rebuild_chunks_;
+
+    int debounce_ms_;
+    int max_delay_ms_;
+
+    bool busy_;
+    bool flush_requested_;
+    bool stop_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_AnnotationWriter_hpp */
@@ -0,0 +1,94 @@
+#ifndef sonarlog_annotation_BoundedQueue_hpp
+#define sonarlog_annotation_BoundedQueue_hpp
+
+#include <deque>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace sonarlog_annotation {
+
+/*
+ * Blocking queue with a fixed capacity shared by producer and consumer
+ * threads. Closing the queue wakes every waiting thread, the remaining
+ * items can still be popped.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity)
+        , closed_(false)
+    {
+    }
+
+    // blocks while the queue is full, returns false if the queue is closed
+    bool push(const T& item) {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!closed_ && items_.size() >= capacity_) {
+            not_full_.wait(lock);
+        }
+
+        if (closed_) {
+            return false;
+        }
+
+        items_.push_back(item);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // blocks while the queue is empty, returns false once it is closed and drained
+    bool pop(T& item) {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!closed_ && items_.empty()) {
+            not_empty_.wait(lock);
+        }
+
+        if (items_.empty()) {
+            return false;
+        }
+
+        item = items_.front();
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        boost::mutex::scoped_lock lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    // drop the queued items and accept new ones again
+    void reset() {
+        boost::mutex::scoped_lock lock(mutex_);
+        items_.clear();
+        closed_ = false;
+        not_full_.notify_all();
+    }
+
+    size_t size() {
+        boost::mutex::scoped_lock lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_;
+    boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+    boost::condition_variable not_full_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_BoundedQueue_hpp */
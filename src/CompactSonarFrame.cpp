@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "CompactSonarFrame.hpp"
+
+namespace sonarlog_annotation {
+
+bool SonarGeometry::operator<(const SonarGeometry& other) const {
+    if (bin_count != other.bin_count) return bin_count < other.bin_count;
+    if (beam_count != other.beam_count) return beam_count < other.beam_count;
+    if (beam_width.getRad() != other.beam_width.getRad()) return beam_width.getRad() < other.beam_width.getRad();
+    if (beam_height.getRad() != other.beam_height.getRad()) return beam_height.getRad() < other.beam_height.getRad();
+    if (bearings.size() != other.bearings.size()) return bearings.size() < other.bearings.size();
+
+    for (size_t i = 0; i < bearings.size(); i++) {
+        if (bearings[i].getRad() != other.bearings[i].getRad()) {
+            return bearings[i].getRad() < other.bearings[i].getRad();
+        }
+    }
+
+    return false;
+}
+
+SonarGeometryPtr SonarGeometryTable::geometry(const base::samples::Sonar& sample) {
+    boost::shared_ptr<SonarGeometry> geometry(new SonarGeometry());
+    geometry->bin_count = sample.bin_count;
+    geometry->beam_count = sample.beam_count;
+    geometry->beam_width = sample.beam_width;
+    geometry->beam_height = sample.beam_height;
+    geometry->bearings = sample.bearings;
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    std::map<SonarGeometryPtr, SonarGeometryPtr, Less>::iterator it = geometries_.find(geometry);
+    if (it != geometries_.end()) {
+        return it->second;
+    }
+
+    geometries_.insert(std::make_pair(SonarGeometryPtr(geometry), SonarGeometryPtr(geometry)));
+    return geometry;
+}
+
+void SonarGeometryTable::clear() {
+    boost::mutex::scoped_lock lock(mutex_);
+    geometries_.clear();
+}
+
+size_t SonarGeometryTable::size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return geometries_.size();
+}
+
+CompactSonarFrame::CompactSonarFrame(const base::samples::Sonar& sample, const SonarGeometryPtr& geometry, BinEncoding encoding)
+    : geometry_(geometry)
+    , encoding_(encoding)
+    , time_(sample.time)
+    , timestamps_(sample.timestamps)
+    , bin_duration_(sample.bin_duration)
+    , speed_of_sound_(sample.speed_of_sound)
+    , offset_(0)
+    , scale_(0)
+{
+    encodeBins(sample.bins);
+}
+
+void CompactSonarFrame::rehydrate(base::samples::Sonar& sample) const {
+    sample.time = time_;
+    sample.timestamps = timestamps_;
+    sample.bin_duration = bin_duration_;
+    sample.speed_of_sound = speed_of_sound_;
+    sample.bin_count = geometry_->bin_count;
+    sample.beam_count = geometry_->beam_count;
+    sample.beam_width = geometry_->beam_width;
+    sample.beam_height = geometry_->beam_height;
+    sample.bearings = geometry_->bearings;
+    decodeBins(sample.bins);
+}
+
+void CompactSonarFrame::decodeBins(std::vector<float>& bins) const {
+    switch (encoding_) {
+        case kBinEncodingFloat:
+            bins = bins32_;
+            break;
+        case kBinEncoding16Bit:
+            bins.resize(bins16_.size());
+            for (size_t i = 0; i < bins16_.size(); i++) {
+                bins[i] = offset_ + bins16_[i] * scale_;
+            }
+            break;
+        case kBinEncodingHalfFloat:
+            bins.resize(bins16_.size());
+            for (size_t i = 0; i < bins16_.size(); i++) {
+                bins[i] = halfToFloat(bins16_[i]);
+            }
+            break;
+        case kBinEncoding8Bit:
+            bins.resize(bins8_.size());
+            for (size_t i = 0; i < bins8_.size(); i++) {
+                bins[i] = offset_ + bins8_[i] * scale_;
+            }
+            break;
+    }
+}
+
+size_t CompactSonarFrame::byteSize() const {
+    return sizeof(*this) +
+           timestamps_.capacity() * sizeof(base::Time) +
+           bins32_.capacity() * sizeof(float) +
+           bins16_.capacity() * sizeof(uint16_t) +
+           bins8_.capacity() * sizeof(uint8_t);
+}
+
+void CompactSonarFrame::encodeBins(const std::vector<float>& bins) {
+    if (encoding_ == kBinEncodingFloat) {
+        bins32_ = bins;
+        return;
+    }
+
+    if (encoding_ == kBinEncodingHalfFloat) {
+        bins16_.resize(bins.size());
+        for (size_t i = 0; i < bins.size(); i++) {
+            bins16_[i] = floatToHalf(bins[i]);
+        }
+        return;
+    }
+
+    const float levels = (encoding_ == kBinEncoding8Bit) ? 255.0f : 65535.0f;
+
+    if (!bins.empty()) {
+        float min_value = bins[0];
+        float max_value = bins[0];
+        for (size_t i = 1; i < bins.size(); i++) {
+            min_value = std::min(min_value, bins[i]);
+            max_value = std::max(max_value, bins[i]);
+        }
+        offset_ = min_value;
+        scale_ = (max_value - min_value) / levels;
+    }
+
+    const float inverse_scale = (scale_ > 0) ? 1.0f / scale_ : 0.0f;
+
+    if (encoding_ == kBinEncoding8Bit) {
+        bins8_.resize(bins.size());
+        for (size_t i = 0; i < bins.size(); i++) {
+            bins8_[i] = (uint8_t)((bins[i] - offset_) * inverse_scale + 0.5f);
+        }
+    }
+    else {
+        bins16_.resize(bins.size());
+        for (size_t i = 0; i < bins.size(); i++) {
+            bins16_[i] = (uint16_t)((bins[i] - offset_) * inverse_scale + 0.5f);
+        }
+    }
+}
+
+uint16_t CompactSonarFrame::floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    int32_t exponent = (int32_t)float_exponent - 127 + 15;
+
+    // infinity and nan
+    if (float_exponent == 0xff) {
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+
+    // overflow
+    if (exponent >= 0x1f) {
+        return sign | 0x7c00;
+    }
+
+    // subnormal half or zero
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) half++;
+        return sign | half;
+    }
+
+    // round to nearest, a carry into the exponent is still correct
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++;
+    return half;
+}
+
+float CompactSonarFrame::halfToFloat(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        float subnormal = std::ldexp((float)mantissa, -24);
+        return sign ? -subnormal : subnormal;
+    }
+
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,115 @@
+#ifndef sonarlog_annotation_CompactSonarFrame_hpp
+#define sonarlog_annotation_CompactSonarFrame_hpp
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <base/samples/Sonar.hpp>
+
+namespace sonarlog_annotation {
+
+enum BinEncoding {
+    kBinEncodingFloat = 0,
+    kBinEncoding16Bit,
+    kBinEncodingHalfFloat,
+    kBinEncoding8Bit
+};
+
+/*
+ * Geometry of a sonar frame, shared by every frame of the same geometry.
+ */
+struct SonarGeometry {
+    bool operator<(const SonarGeometry& other) const;
+
+    uint32_t bin_count;
+    uint32_t beam_count;
+    base::Angle beam_width;
+    base::Angle beam_height;
+    std::vector<base::Angle> bearings;
+};
+
+typedef boost::shared_ptr<const SonarGeometry> SonarGeometryPtr;
+
+/*
+ * Thread safe table that hands out one geometry instance per distinct
+ * geometry.
+ */
+class SonarGeometryTable {
+public:
+
+    SonarGeometryPtr geometry(const base::samples::Sonar& sample);
+
+    void clear();
+
+    size_t size();
+
+private:
+
+    struct Less {
+        bool operator()(const SonarGeometryPtr& a, const SonarGeometryPtr& b) const {
+            return *a < *b;
+        }
+    };
+
+    std::map<SonarGeometryPtr, SonarGeometryPtr, Less> geometries_;
+    boost::mutex mutex_;
+};
+
+/*
+ * Sonar frame with its bins quantized and its geometry shared.
+ *
+ * The 8 and 16 bit encodings map the range of the frame bins linearly onto
+ * the integer range (per-frame offset and scale), the half float encoding
+ * keeps the bins as IEEE 754 binary16.
+ */
+class CompactSonarFrame {
+public:
+
+    CompactSonarFrame(const base::samples::Sonar& sample, const SonarGeometryPtr& geometry, BinEncoding encoding);
+
+    // rebuild the full sonar sample
+    void rehydrate(base::samples::Sonar& sample) const;
+
+    void decodeBins(std::vector<float>& bins) const;
+
+    const SonarGeometryPtr& geometry() const {
+        return geometry_;
+    }
+
+    BinEncoding encoding() const {
+        return encoding_;
+    }
+
+    // bytes held by the frame, the shared geometry excluded
+    size_t byteSize() const;
+
+    static uint16_t floatToHalf(float value);
+    static float halfToFloat(uint16_t value);
+
+private:
+
+    void encodeBins(const std::vector<float>& bins);
+
+    SonarGeometryPtr geometry_;
+    BinEncoding encoding_;
+
+    base::Time time_;
+    std::vector<base::Time> timestamps_;
+    base::Time bin_duration_;
+    float speed_of_sound_;
+
+    float offset_;
+    float scale_;
+
+    std::vector<float> bins32_;
+    std::vector<uint16_t> bins16_;
+    std::vector<uint8_t> bins8_;
+};
+
+typedef boost::shared_ptr<const CompactSonarFrame> CompactSonarFramePtr;
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_CompactSonarFrame_hpp */
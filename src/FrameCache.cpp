@@ -0,0 +1,77 @@
+#include "FrameCache.hpp"
+
+namespace sonarlog_annotation {
+
+FrameCache::FrameCache(size_t capacity)
+    : capacity_(capacity)
+{
+}
+
+bool FrameCache::find(int sample_index, DisplayMode mode, cv::Mat& frame) {
+    FrameMap::iterator it = frames_.find(Key(sample_index, mode));
+
+    if (it == frames_.end()) {
+        statistics_.misses++;
+        return false;
+    }
+
+    order_.splice(order_.begin(), order_, it->second.second);
+    frame = it->second.first;
+    statistics_.hits++;
+    return true;
+}
+
+bool FrameCache::contains(int sample_index, DisplayMode mode) const {
+    return frames_.find(Key(sample_index, mode)) != frames_.end();
+}
+
+void FrameCache::insert(int sample_index, DisplayMode mode, const cv::Mat& frame) {
+    Key key(sample_index, mode);
+    FrameMap::iterator it = frames_.find(key);
+
+    if (it != frames_.end()) {
+        statistics_.bytes -= frameBytes(it->second.first);
+        it->second.first = frame;
+        statistics_.bytes += frameBytes(frame);
+        order_.splice(order_.begin(), order_, it->second.second);
+    }
+    else {
+        order_.push_front(key);
+        frames_.insert(std::make_pair(key, std::make_pair(frame, order_.begin())));
+        statistics_.bytes += frameBytes(frame);
+        statistics_.frames = frames_.size();
+    }
+
+    evict();
+}
+
+void FrameCache::clear() {
+    order_.clear();
+    frames_.clear();
+    statistics_.frames = 0;
+    statistics_.bytes = 0;
+}
+
+void FrameCache::resetStatistics() {
+    statistics_.hits = 0;
+    statistics_.misses = 0;
+    statistics_.evictions = 0;
+}
+
+void FrameCache::setCapacity(size_t capacity) {
+    capacity_ = capacity;
+    evict();
+}
+
+void FrameCache::evict() {
+    while (statistics_.bytes > capacity_ && !order_.empty()) {
+        FrameMap::iterator it = frames_.find(order_.back());
+        statistics_.bytes -= frameBytes(it->second.first);
+        frames_.erase(it);
+        order_.pop_back();
+        statistics_.evictions++;
+    }
+    statistics_.frames = frames_.size();
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,87 @@
+#ifndef sonarlog_annotation_FrameCache_hpp
+#define sonarlog_annotation_FrameCache_hpp
+
+#include <list>
+#include <map>
+#include <utility>
+#include <opencv2/opencv.hpp>
+#include "FrameRenderer.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Least recently used cache of the rendered display frames.
+ *
+ * The frames are keyed by sample index and display mode, the cache evicts
+ * the oldest frames when the memory used by the images exceeds the
+ * capacity given in bytes.
+ */
+class FrameCache {
+public:
+
+    static const size_t kDefaultCapacity = 256 * 1024 * 1024;
+
+    struct Statistics {
+        Statistics()
+            : hits(0)
+            , misses(0)
+            , evictions(0)
+            , frames(0)
+            , bytes(0)
+        {
+        }
+
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t frames;
+        size_t bytes;
+    };
+
+    explicit FrameCache(size_t capacity = kDefaultCapacity);
+
+    virtual ~FrameCache() {
+    }
+
+    bool find(int sample_index, DisplayMode mode, cv::Mat& frame);
+
+    bool contains(int sample_index, DisplayMode mode) const;
+
+    void insert(int sample_index, DisplayMode mode, const cv::Mat& frame);
+
+    // the hit, miss and eviction counts are kept
+    void clear();
+
+    void resetStatistics();
+
+    void setCapacity(size_t capacity);
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    const Statistics& statistics() const {
+        return statistics_;
+    }
+
+private:
+
+    typedef std::pair<int, DisplayMode> Key;
+    typedef std::list<Key> KeyList;
+    typedef std::map<Key, std::pair<cv::Mat, KeyList::iterator> > FrameMap;
+
+    static size_t frameBytes(const cv::Mat& frame) {
+        return frame.total() * frame.elemSize();
+    }
+
+    void evict();
+
+    KeyList order_;
+    FrameMap frames_;
+    size_t capacity_;
+    Statistics statistics_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_FrameCache_hpp */
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "FrameColorizer.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+inline uchar toByte(float value) {
+    return (uchar)cvRound(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+}
+
+// scale and clamp one pixel the way convertTo(CV_8U, 255.0) does
+inline int intensityIndex(float value) {
+    float scaled = value * 255.0f;
+    if (!(scaled > 0.0f)) return 0;
+    if (scaled > 255.0f) return 255;
+    return cvRound(scaled);
+}
+
+inline void copyColor(const uchar* table, int index, uchar* dst) {
+    const uchar* color = table + index * 3;
+    dst[0] = color[0];
+    dst[1] = color[1];
+    dst[2] = color[2];
+}
+
+} /* namespace */
+
+FrameColorizer::FrameColorizer(DisplayPalette palette, double gamma)
+    : palette_(palette)
+    , gamma_(gamma)
+{
+    buildTable();
+}
+
+void FrameColorizer::setPalette(DisplayPalette palette) {
+    if (palette != palette_) {
+        palette_ = palette;
+        buildTable();
+    }
+}
+
+void FrameColorizer::setGamma(double gamma) {
+    if (gamma > 0 && gamma != gamma_) {
+        gamma_ = gamma;
+        buildTable();
+    }
+}
+
+void FrameColorizer::apply(const cv::Mat& image, cv::Mat& frame) const {
+    CV_Assert(image.type() == CV_32F);
+    frame.create(image.size(), CV_8UC3);
+
+    const int width = image.cols;
+
+    for (int y = 0; y < image.rows; y++) {
+        const float* src = image.ptr<float>(y);
+        uchar* dst = frame.ptr<uchar>(y);
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 lower = _mm_setzero_ps();
+        const __m128 upper = _mm_set1_ps(255.0f);
+        int indices[4];
+
+        // max_ps returns its second operand for a nan pixel, nan maps to 0
+        for (; x + 4 <= width; x += 4) {
+            __m128 value = _mm_mul_ps(_mm_loadu_ps(src + x), scale);
+            value = _mm_min_ps(_mm_max_ps(value, lower), upper);
+            _mm_storeu_si128((__m128i*)indices, _mm_cvtps_epi32(value));
+
+            copyColor(table_, indices[0], dst + x * 3);
+            copyColor(table_, indices[1], dst + x * 3 + 3);
+            copyColor(table_, indices[2], dst + x * 3 + 6);
+            copyColor(table_, indices[3], dst + x * 3 + 9);
+        }
+#endif
+
+        for (; x < width; x++) {
+            copyColor(table_, intensityIndex(src[x]), dst + x * 3);
+        }
+    }
+}
+
+const char* FrameColorizer::paletteName(DisplayPalette palette) {
+    switch (palette) {
+        case kPaletteGray: return "gray";
+        case kPaletteJet: return "jet";
+        case kPaletteHot: return "hot";
+        case kPaletteBone: return "bone";
+    }
+    return "";
+}
+
+void FrameColorizer::buildTable() {
+    for (int i = 0; i < 256; i++) {
+        float value = std::pow(i / 255.0f, (float)gamma_);
+        paletteColor(palette_, value, table_ + i * 3);
+    }
+}
+
+void FrameColorizer::paletteColor(DisplayPalette palette, float value, uchar* bgr) {
+    float r, g, b;
+
+    switch (palette) {
+        case kPaletteJet:
+            r = 1.5f - std::fabs(4.0f * value - 3.0f);
+            g = 1.5f - std::fabs(4.0f * value - 2.0f);
+            b = 1.5f - std::fabs(4.0f * value - 1.0f);
+            break;
+        case kPaletteHot:
+            r = value * 3.0f;
+            g = value * 3.0f - 1.0f;
+            b = value * 3.0f - 2.0f;
+            break;
+        case kPaletteBone:
+            r = (value < 0.75f) ? value * 0.875f : value * 1.875f - 0.875f;
+            g = (value < 0.375f) ? value * 0.875f : (value < 0.75f) ? value * 1.2083f - 0.125f : value * 0.875f + 0.125f;
+            b = (value < 0.375f) ? value * 1.2083f : value * 0.875f + 0.125f;
+            break;
+        default:
+            r = g = b = value;
+            break;
+    }
+
+    bgr[0] = toByte(b);
+    bgr[1] = toByte(g);
+    bgr[2] = toByte(r);
+}
+
+} /* namespace sonarlog_annotation */
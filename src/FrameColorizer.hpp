@@ -0,0 +1,63 @@
+#ifndef sonarlog_annotation_FrameColorizer_hpp
+#define sonarlog_annotation_FrameColorizer_hpp
+
+#include <opencv2/opencv.hpp>
+
+namespace sonarlog_annotation {
+
+enum DisplayPalette {
+    kPaletteGray = 0,
+    kPaletteJet,
+    kPaletteHot,
+    kPaletteBone
+};
+
+/*
+ * Converts a float intensity image in [0, 1] into the BGR image shown by
+ * the annotation tool.
+ *
+ * Scaling, clamping, the gamma correction, the palette lookup and the
+ * expansion to three channels are done in a single pass straight into the
+ * output image. The gamma and the palette are folded into a 256 entry
+ * table that is rebuilt only when one of them changes.
+ */
+class FrameColorizer {
+public:
+
+    FrameColorizer(DisplayPalette palette = kPaletteGray, double gamma = 1.0);
+
+    void setPalette(DisplayPalette palette);
+
+    void setGamma(double gamma);
+
+    DisplayPalette palette() const {
+        return palette_;
+    }
+
+    double gamma() const {
+        return gamma_;
+    }
+
+    // image must be CV_32F, frame is (re)allocated as CV_8UC3
+    void apply(const cv::Mat& image, cv::Mat& frame) const;
+
+    static const char* paletteName(DisplayPalette palette);
+
+    static const int kPaletteCount = kPaletteBone + 1;
+
+private:
+
+    void buildTable();
+
+    static void paletteColor(DisplayPalette palette, float value, uchar* bgr);
+
+    DisplayPalette palette_;
+    double gamma_;
+
+    // BGR triple per 8-bit intensity
+    uchar table_[256 * 3];
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_FrameColorizer_hpp */
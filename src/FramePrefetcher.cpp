@@ -0,0 +1,146 @@
+#include "FramePrefetcher.hpp"
+
+namespace sonarlog_annotation {
+
+class FramePrefetchJob : public QRunnable {
+public:
+    FramePrefetchJob(FramePrefetcher* prefetcher, int sample_index, DisplayMode mode,
+                     DisplayPalette palette, double gamma, int generation)
+        : prefetcher_(prefetcher)
+        , sample_index_(sample_index)
+        , mode_(mode)
+        , palette_(palette)
+        , gamma_(gamma)
+        , generation_(generation)
+    {
+    }
+
+    void run() {
+        prefetcher_->render(sample_index_, mode_, palette_, gamma_, generation_);
+    }
+
+private:
+    FramePrefetcher* prefetcher_;
+    int sample_index_;
+    DisplayMode mode_;
+    DisplayPalette palette_;
+    double gamma_;
+    int generation_;
+};
+
+namespace {
+
+// each pool thread keeps its own renderer
+QThreadStorage<FrameRenderer*> frame_renderers;
+
+FrameRenderer* threadFrameRenderer() {
+    if (!frame_renderers.hasLocalData()) {
+        frame_renderers.setLocalData(new FrameRenderer());
+    }
+    return frame_renderers.localData();
+}
+
+} /* namespace */
+
+FramePrefetcher::FramePrefetcher(SonarSampleStore* sample_store, FrameCache* frame_cache, QObject* parent)
+    : QObject(parent)
+    , sample_store_(sample_store)
+    , frame_cache_(frame_cache)
+    , generation_(0)
+    , depth_(4)
+    , last_index_(-1)
+    , last_mode_(kDisplayRaw)
+    , palette_(kPaletteGray)
+    , gamma_(1.0)
+{
+    qRegisterMetaType<cv::Mat>("cv::Mat");
+    pool_.setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 3));
+}
+
+FramePrefetcher::~FramePrefetcher() {
+    cancel();
+    waitForDone();
+}
+
+void FramePrefetcher::schedule(int sample_index, int direction, DisplayMode mode) {
+    if (mode != last_mode_ || qAbs(sample_index - last_index_) > 1) {
+        cancel();
+    }
+
+    last_index_ = sample_index;
+    last_mode_ = mode;
+
+    direction = (direction < 0) ? -1 : 1;
+
+    for (int i = 1; i <= depth_; i++) {
+        enqueue(sample_index + direction * i, mode);
+    }
+    enqueue(sample_index - direction, mode);
+}
+
+void FramePrefetcher::cancel() {
+    generation_.fetchAndAddOrdered(1);
+    pending_.clear();
+}
+
+void FramePrefetcher::setPalette(DisplayPalette palette, double gamma) {
+    if (palette != palette_ || gamma != gamma_) {
+        cancel();
+        palette_ = palette;
+        gamma_ = gamma;
+    }
+}
+
+void FramePrefetcher::waitForDone() {
+    pool_.waitForDone();
+}
+
+void FramePrefetcher::enqueue(int sample_index, DisplayMode mode) {
+    if (sample_index < 0 || sample_index >= (int)sample_store_->size()) {
+        return;
+    }
+
+    Key key(sample_index, mode);
+    if (pending_.contains(key) || frame_cache_->contains(sample_index, mode)) {
+        return;
+    }
+
+    pending_.insert(key);
+    pool_.start(new FramePrefetchJob(this, sample_index, mode, palette_, gamma_, (int)generation_));
+}
+
+void FramePrefetcher::render(int sample_index, DisplayMode mode, DisplayPalette palette, double gamma, int generation) {
+    if (isStale(generation)) {
+        return;
+    }
+
+    cv::Mat frame;
+    SonarSamplePtr sample = sample_store_->sample(sample_index);
+
+    if (sample && !isStale(generation)) {
+        FrameRenderer* frame_renderer = threadFrameRenderer();
+        frame_renderer->setPalette(palette);
+        frame_renderer->setGamma(gamma);
+        frame_renderer->render(*sample, mode, frame);
+    }
+
+    QMetaObject::invokeMethod(this, "frameRendered", Qt::QueuedConnection,
+                              Q_ARG(int, sample_index),
+                              Q_ARG(int, mode),
+                              Q_ARG(int, generation),
+                              Q_ARG(cv::Mat, frame));
+}
+
+void FramePrefetcher::frameRendered(int sample_index, int mode, int generation, const cv::Mat& frame) {
+    if (isStale(generation)) {
+        return;
+    }
+
+    pending_.remove(Key(sample_index, mode));
+
+    if (!frame.empty()) {
+        emit frameReady(sample_index, mode, frame);
+    }
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,82 @@
+#ifndef sonarlog_annotation_FramePrefetcher_hpp
+#define sonarlog_annotation_FramePrefetcher_hpp
+
+#include <QtCore>
+#include <opencv2/opencv.hpp>
+#include "FrameCache.hpp"
+#include "SonarSampleStore.hpp"
+
+Q_DECLARE_METATYPE(cv::Mat)
+
+namespace sonarlog_annotation {
+
+/*
+ * Renders the frames around the current sample on a small thread pool.
+ *
+ * The frames ahead in the direction of travel and the one behind are
+ * scheduled, jumping to another sample or changing the display mode
+ * discards the jobs that are still queued. Rendered frames are delivered
+ * to the thread that owns the prefetcher through frameReady.
+ */
+class FramePrefetcher : public QObject {
+    Q_OBJECT
+
+public:
+
+    FramePrefetcher(SonarSampleStore* sample_store, FrameCache* frame_cache, QObject* parent = 0);
+
+    virtual ~FramePrefetcher();
+
+    void schedule(int sample_index, int direction, DisplayMode mode);
+
+    void cancel();
+
+    void waitForDone();
+
+    void setDepth(int depth) {
+        depth_ = depth;
+    }
+
+    // the frames are not keyed by palette, the caller clears the cache
+    void setPalette(DisplayPalette palette, double gamma);
+
+    int depth() const {
+        return depth_;
+    }
+
+signals:
+    void frameReady(int sample_index, int mode, const cv::Mat& frame);
+
+private slots:
+    void frameRendered(int sample_index, int mode, int generation, const cv::Mat& frame);
+
+private:
+
+    friend class FramePrefetchJob;
+
+    typedef QPair<int, int> Key;
+
+    void enqueue(int sample_index, DisplayMode mode);
+    void render(int sample_index, DisplayMode mode, DisplayPalette palette, double gamma, int generation);
+
+    bool isStale(int generation) const {
+        return generation != (int)generation_;
+    }
+
+    SonarSampleStore* sample_store_;
+    FrameCache* frame_cache_;
+
+    QThreadPool pool_;
+    QAtomicInt generation_;
+    QSet<Key> pending_;
+
+    int depth_;
+    int last_index_;
+    DisplayMode last_mode_;
+    DisplayPalette palette_;
+    double gamma_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_FramePrefetcher_hpp */
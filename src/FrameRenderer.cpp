@@ -0,0 +1,38 @@
+#include <sonar_processing/ImageFiltering.hpp>
+#include "FrameRenderer.hpp"
+#include "Profiler.hpp"
+
+namespace sonarlog_annotation {
+
+void FrameRenderer::reset(const base::samples::Sonar& sample) {
+    ScopedTimer timer("render.remap");
+    remap_table_ = remap_table_cache_.table(sample);
+    remap_table_->remap(sample.bins, cart_image_);
+}
+
+void FrameRenderer::render(DisplayMode mode, cv::Mat& frame) {
+    if (!remap_table_) {
+        return;
+    }
+
+    const cv::Mat& cart_mask = remap_table_->cart_mask();
+    const cv::Mat* filtered_image = &cart_image_;
+
+    if (mode == kDisplayPreprocessed) {
+        ScopedTimer timer("render.preprocessing");
+        sonar_image_preprocessing_.Apply(cart_image_, cart_mask, filtered_image_, filtered_mask_, 0.5);
+        filtered_image = &filtered_image_;
+    }
+    else if (mode == kDisplayEnhanced) {
+        ScopedTimer timer("render.enhancement");
+        sonar_processing::image_filtering::insonification_correction(cart_image_,
+                                                                     cart_mask,
+                                                                     filtered_image_);
+        filtered_image = &filtered_image_;
+    }
+
+    ScopedTimer timer("render.convert");
+    colorizer_.apply(*filtered_image, frame);
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,89 @@
+#ifndef sonarlog_annotation_FrameRenderer_hpp
+#define sonarlog_annotation_FrameRenderer_hpp
+
+#include <opencv2/opencv.hpp>
+#include <base/samples/Sonar.hpp>
+#include <sonar_processing/SonarImagePreprocessing.hpp>
+#include "FrameColorizer.hpp"
+#include "RemapTable.hpp"
+
+namespace sonarlog_annotation {
+
+enum DisplayMode {
+    kDisplayRaw = 0,
+    kDisplayEnhanced,
+    kDisplayPreprocessed
+};
+
+/*
+ * Renders a sonar sample into the BGR image shown by the annotation tool.
+ *
+ * The projection uses the remap table of the sample geometry, the tables
+ * are shared by all renderers using the same cache. A renderer is not
+ * thread safe, each thread needs its own instance.
+ *
+ * The renderer is meant to be long lived: the preprocessing stage and the
+ * intermediate images of every stage are kept between frames, so frames of
+ * the same geometry are rendered without reallocating them.
+ */
+class FrameRenderer {
+public:
+
+    explicit FrameRenderer(RemapTableCache& remap_table_cache = RemapTableCache::shared())
+        : remap_table_cache_(remap_table_cache)
+    {
+    }
+
+    virtual ~FrameRenderer() {
+    }
+
+    void reset(const base::samples::Sonar& sample);
+
+    void render(DisplayMode mode, cv::Mat& frame);
+
+    void render(const base::samples::Sonar& sample, DisplayMode mode, cv::Mat& frame) {
+        reset(sample);
+        render(mode, frame);
+    }
+
+    int cart_to_polar_index(int x, int y) const {
+        return (remap_table_) ? remap_table_->cart_to_polar_index(x, y) : -1;
+    }
+
+    const RemapTablePtr& remap_table() const {
+        return remap_table_;
+    }
+
+    const cv::Mat& cart_image() const {
+        return cart_image_;
+    }
+
+    void setPalette(DisplayPalette palette) {
+        colorizer_.setPalette(palette);
+    }
+
+    void setGamma(double gamma) {
+        colorizer_.setGamma(gamma);
+    }
+
+    const FrameColorizer& colorizer() const {
+        return colorizer_;
+    }
+
+private:
+
+    RemapTableCache& remap_table_cache_;
+    RemapTablePtr remap_table_;
+    sonar_processing::SonarImagePreprocessing sonar_image_preprocessing_;
+
+    // stage buffers, reallocated only when the geometry changes
+    cv::Mat cart_image_;
+    cv::Mat filtered_image_;
+    cv::Mat filtered_mask_;
+
+    FrameColorizer colorizer_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_FrameRenderer_hpp */
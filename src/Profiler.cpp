@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <time.h>
+#include "Profiler.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+// number of events kept for the trace export
+const size_t kDefaultTraceCapacity = 100000;
+
+int histogramBucket(int64_t duration_us) {
+    int bucket = 0;
+    while (duration_us > 1 && bucket < Profiler::kHistogramBuckets - 1) {
+        duration_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"' || value[i] == '\\') out << '\\';
+        out << value[i];
+    }
+    out << '"';
+}
+
+} /* namespace */
+
+volatile bool Profiler::enabled_ = (getenv("SONARLOG_PROFILE") != NULL);
+
+int64_t Profiler::StageStatistics::percentile_us(double p) const {
+    uint64_t target = (uint64_t)(p / 100.0 * count);
+    uint64_t accumulated = 0;
+
+    for (int bucket = 0; bucket < kHistogramBuckets; bucket++) {
+        accumulated += histogram[bucket];
+        if (accumulated > target || accumulated == count) {
+            return std::min((int64_t)1 << (bucket + 1), max_us);
+        }
+    }
+
+    return max_us;
+}
+
+Profiler::Profiler()
+    : trace_capacity_(kDefaultTraceCapacity)
+    , trace_next_(0)
+    , thread_count_(0)
+{
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void Profiler::record(const char* stage, int64_t start_us, int64_t duration_us) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    StageStatistics& statistics = stages_[stage];
+    if (statistics.count == 0) {
+        statistics.name = stage;
+        statistics.min_us = duration_us;
+        statistics.max_us = duration_us;
+    }
+    else {
+        statistics.min_us = std::min(statistics.min_us, duration_us);
+        statistics.max_us = std::max(statistics.max_us, duration_us);
+    }
+    statistics.count++;
+    statistics.total_us += duration_us;
+    statistics.histogram[histogramBucket(duration_us)]++;
+
+    if (trace_capacity_ == 0) {
+        return;
+    }
+
+    TraceEvent event;
+    event.stage = stage;
+    event.start_us = start_us;
+    event.duration_us = duration_us;
+    event.thread_id = threadId();
+
+    if (trace_.size() < trace_capacity_) {
+        trace_.push_back(event);
+    }
+    else {
+        trace_[trace_next_] = event;
+    }
+    trace_next_ = (trace_next_ + 1) % trace_capacity_;
+}
+
+std::vector<Profiler::StageStatistics> Profiler::statistics() {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    std::vector<StageStatistics> statistics;
+    std::map<std::string, StageStatistics>::const_iterator it;
+    for (it = stages_.begin(); it != stages_.end(); it++) {
+        statistics.push_back(it->second);
+    }
+    return statistics;
+}
+
+void Profiler::reset() {
+    boost::mutex::scoped_lock lock(mutex_);
+    stages_.clear();
+    trace_.clear();
+    trace_next_ = 0;
+}
+
+void Profiler::setTraceCapacity(size_t capacity) {
+    boost::mutex::scoped_lock lock(mutex_);
+    trace_capacity_ = capacity;
+    trace_.clear();
+    trace_next_ = 0;
+}
+
+bool Profiler::writeChromeTrace(const std::string& filepath) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    std::ofstream out(filepath.c_str());
+    if (!out) {
+        return false;
+    }
+
+    // oldest event first once the ring buffer wrapped
+    size_t first = (trace_.size() < trace_capacity_) ? 0 : trace_next_;
+
+    out << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < trace_.size(); i++) {
+        const TraceEvent& event = trace_[(first + i) % trace_.size()];
+        out << "{\"name\":";
+        writeJsonString(out, event.stage);
+        out << ",\"cat\":\"sonarlog_annotation\",\"ph\":\"X\""
+            << ",\"ts\":" << event.start_us
+            << ",\"dur\":" << event.duration_us
+            << ",\"pid\":1,\"tid\":" << event.thread_id << "}"
+            << ((i + 1 < trace_.size()) ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+
+    return out.good();
+}
+
+int Profiler::threadId() {
+    if (!thread_id_.get()) {
+        thread_id_.reset(new int(++thread_count_));
+    }
+    return *thread_id_;
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,132 @@
+#ifndef sonarlog_annotation_Profiler_hpp
+#define sonarlog_annotation_Profiler_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace sonarlog_annotation {
+
+/*
+ * Process wide collector of stage timings.
+ *
+ * Stages are timed with ScopedTimer. Each stage keeps its count, total,
+ * minimum and maximum and a histogram with power of two buckets in
+ * microseconds; the most recent events are kept in a ring buffer that can
+ * be exported in the Chrome trace event format (chrome://tracing).
+ *
+ * The profiler is disabled by default, a disabled ScopedTimer costs one
+ * flag test. Setting SONARLOG_PROFILE in the environment enables it at
+ * startup.
+ */
+class Profiler {
+public:
+
+    static const int kHistogramBuckets = 32;
+
+    struct StageStatistics {
+        StageStatistics()
+            : count(0)
+            , total_us(0)
+            , min_us(0)
+            , max_us(0)
+            , histogram(kHistogramBuckets, 0)
+        {
+        }
+
+        double mean_us() const {
+            return (count) ? (double)total_us / count : 0;
+        }
+
+        // upper bound of the histogram bucket holding the percentile
+        int64_t percentile_us(double p) const;
+
+        std::string name;
+        uint64_t count;
+        int64_t total_us;
+        int64_t min_us;
+        int64_t max_us;
+        std::vector<uint64_t> histogram;
+    };
+
+    static Profiler& instance();
+
+    static bool enabled() {
+        return enabled_;
+    }
+
+    static void setEnabled(bool enabled) {
+        enabled_ = enabled;
+    }
+
+    // monotonic clock in microseconds
+    static int64_t now();
+
+    // stage must be a string literal, only its address is stored
+    void record(const char* stage, int64_t start_us, int64_t duration_us);
+
+    std::vector<StageStatistics> statistics();
+
+    void reset();
+
+    void setTraceCapacity(size_t capacity);
+
+    bool writeChromeTrace(const std::string& filepath);
+
+private:
+
+    struct TraceEvent {
+        const char* stage;
+        int64_t start_us;
+        int64_t duration_us;
+        int thread_id;
+    };
+
+    Profiler();
+
+    int threadId();
+
+    static volatile bool enabled_;
+
+    std::map<std::string, StageStatistics> stages_;
+
+    std::vector<TraceEvent> trace_;
+    size_t trace_capacity_;
+    size_t trace_next_;
+
+    boost::thread_specific_ptr<int> thread_id_;
+    int thread_count_;
+
+    boost::mutex mutex_;
+};
+
+/*
+ * Records the time spent in its scope under the given stage name.
+ */
+class ScopedTimer {
+public:
+
+    explicit ScopedTimer(const char* stage)
+        : stage_((Profiler::enabled()) ? stage : 0)
+        , start_us_((stage_) ? Profiler::now() : 0)
+    {
+    }
+
+    ~ScopedTimer() {
+        if (stage_) {
+            Profiler::instance().record(stage_, start_us_, Profiler::now() - start_us_);
+        }
+    }
+
+private:
+
+    const char* stage_;
+    int64_t start_us_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_Profiler_hpp */
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <rock_util/Utilities.hpp>
+#include <sonar_processing/SonarHolder.hpp>
+#include "RemapTable.hpp"
+
+namespace sonarlog_annotation {
+
+RemapTable::RemapTable(const cv::Size& size, const std::vector<int>& cart_to_polar, const cv::Mat& cart_mask)
+    : size_(size)
+    , cart_to_polar_(cart_to_polar)
+    , cart_mask_(cart_mask)
+{
+    buildNearestValid();
+}
+
+bool RemapTable::snap_to_valid(float& x, float& y, float max_distance) const {
+    int ix = (int)x;
+    int iy = (int)y;
+
+    if (is_valid(ix, iy)) {
+        return true;
+    }
+
+    if (nearest_valid_.empty()) {
+        return false;
+    }
+
+    // points off the image take the nearest valid pixel of the border
+    int cx = std::min(std::max(ix, 0), size_.width - 1);
+    int cy = std::min(std::max(iy, 0), size_.height - 1);
+    int nearest = nearest_valid_[cy * size_.width + cx];
+
+    if (nearest == -1) {
+        return false;
+    }
+
+    float nx = nearest % size_.width;
+    float ny = nearest / size_.width;
+
+    if (max_distance >= 0 && (nx - x) * (nx - x) + (ny - y) * (ny - y) > max_distance * max_distance) {
+        return false;
+    }
+
+    x = nx;
+    y = ny;
+    return true;
+}
+
+void RemapTable::buildNearestValid() {
+    if (size_.area() == 0) {
+        return;
+    }
+
+    // the pixels inside the fan are the zero pixels of the distance transform source
+    cv::Mat invalid(size_, CV_8U);
+    std::vector<int> label_offsets(1, -1);
+
+    for (int y = 0; y < size_.height; y++) {
+        uchar* ptr = invalid.ptr<uchar>(y);
+        for (int x = 0; x < size_.width; x++) {
+            int offset = y * size_.width + x;
+            ptr[x] = (cart_to_polar_[offset] == -1) ? 255 : 0;
+
+            // DIST_LABEL_PIXEL labels the zero pixels in raster order starting at 1
+            if (!ptr[x]) label_offsets.push_back(offset);
+        }
+    }
+
+    nearest_valid_.assign(size_.area(), -1);
+
+    if (label_offsets.size() == 1) {
+        return;
+    }
+
+    cv::Mat distance, labels;
+    cv::distanceTransform(invalid, distance, labels, CV_DIST_L2, 5, cv::DIST_LABEL_PIXEL);
+
+    for (int y = 0; y < size_.height; y++) {
+        const int* label = labels.ptr<int>(y);
+        for (int x = 0; x < size_.width; x++) {
+            nearest_valid_[y * size_.width + x] = label_offsets[label[x]];
+        }
+    }
+}
+
+void RemapTable::remap(const std::vector<float>& bins, cv::Mat& cart_image) const {
+    cart_image.create(size_, CV_32F);
+
+    if (cart_to_polar_.empty()) {
+        return;
+    }
+
+    float* dst = cart_image.ptr<float>();
+    const int* index = &cart_to_polar_[0];
+    const int total = size_.area();
+    const int bin_total = bins.size();
+
+    for (int i = 0; i < total; i++) {
+        dst[i] = (index[i] >= 0 && index[i] < bin_total) ? bins[index[i]] : 0.0f;
+    }
+}
+
+bool RemapTableCache::Geometry::operator<(const Geometry& other) const {
+    if (bin_count != other.bin_count) return bin_count < other.bin_count;
+    if (beam_count != other.beam_count) return beam_count < other.beam_count;
+    if (beam_width != other.beam_width) return beam_width < other.beam_width;
+    return bearings < other.bearings;
+}
+
+RemapTablePtr RemapTableCache::table(const base::samples::Sonar& sample) {
+    Geometry geometry;
+    geometry.bin_count = sample.bin_count;
+    geometry.beam_count = sample.beam_count;
+    geometry.beam_width = sample.beam_width.getRad();
+    geometry.bearings.resize(sample.bearings.size());
+    for (size_t i = 0; i < sample.bearings.size(); i++) {
+        geometry.bearings[i] = sample.bearings[i].getRad();
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    TableMap::iterator it = tables_.find(geometry);
+    if (it != tables_.end()) {
+        order_.splice(order_.begin(), order_, it->second.second);
+        return it->second.first;
+    }
+
+    RemapTablePtr table = build(sample);
+    it = tables_.insert(std::make_pair(geometry, std::make_pair(table, GeometryList::iterator()))).first;
+    order_.push_front(&it->first);
+    it->second.second = order_.begin();
+
+    // the renderers holding a dropped table keep it alive
+    while (tables_.size() > capacity_ && !order_.empty()) {
+        tables_.erase(*order_.back());
+        order_.pop_back();
+    }
+
+    return table;
+}
+
+void RemapTableCache::clear() {
+    boost::mutex::scoped_lock lock(mutex_);
+    order_.clear();
+    tables_.clear();
+}
+
+size_t RemapTableCache::size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return tables_.size();
+}
+
+RemapTableCache& RemapTableCache::shared() {
+    // a log rarely switches between more than a few sonar geometries
+    static RemapTableCache cache;
+    return cache;
+}
+
+RemapTablePtr RemapTableCache::build(const base::samples::Sonar& sample) {
+    sonar_processing::SonarHolder sonar_holder;
+    sonar_holder.Reset(sample.bins,
+                       rock_util::Utilities::get_radians(sample.bearings),
+                       sample.beam_width.getRad(),
+                       sample.bin_count,
+                       sample.beam_count);
+
+    cv::Size size = sonar_holder.cart_image_mask().size();
+    std::vector<int> cart_to_polar(size.area(), -1);
+
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            cart_to_polar[y * size.width + x] = sonar_holder.cart_to_polar_index(x, y);
+        }
+    }
+
+    return RemapTablePtr(new RemapTable(size, cart_to_polar, sonar_holder.cart_image_mask().clone()));
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,120 @@
+#ifndef sonarlog_annotation_RemapTable_hpp
+#define sonarlog_annotation_RemapTable_hpp
+
+#include <list>
+#include <map>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <opencv2/opencv.hpp>
+#include <base/samples/Sonar.hpp>
+
+namespace sonarlog_annotation {
+
+/*
+ * Polar to cartesian projection of a sonar geometry.
+ *
+ * Each cartesian pixel holds the index of the polar bin it shows, or -1
+ * when it lies outside of the sonar fan. Each pixel also knows the nearest
+ * pixel inside the fan, so points can be snapped onto the fan in constant
+ * time.
+ */
+class RemapTable {
+public:
+
+    RemapTable(const cv::Size& size, const std::vector<int>& cart_to_polar, const cv::Mat& cart_mask);
+
+    int cart_to_polar_index(int x, int y) const {
+        if (x < 0 || y < 0 || x >= size_.width || y >= size_.height) {
+            return -1;
+        }
+        return cart_to_polar_[y * size_.width + x];
+    }
+
+    bool is_valid(int x, int y) const {
+        return cart_to_polar_index(x, y) != -1;
+    }
+
+    // move the point onto the nearest pixel inside the fan, false when it
+    // is farther than max_distance pixels (a negative distance means no limit)
+    bool snap_to_valid(float& x, float& y, float max_distance = -1) const;
+
+    // project the polar bins into a cartesian float image
+    void remap(const std::vector<float>& bins, cv::Mat& cart_image) const;
+
+    const cv::Size& size() const {
+        return size_;
+    }
+
+    const cv::Mat& cart_mask() const {
+        return cart_mask_;
+    }
+
+    const std::vector<int>& cart_to_polar() const {
+        return cart_to_polar_;
+    }
+
+private:
+
+    void buildNearestValid();
+
+    cv::Size size_;
+    std::vector<int> cart_to_polar_;
+    cv::Mat cart_mask_;
+
+    // pixel offset of the nearest pixel inside the fan, -1 when the fan is empty
+    std::vector<int> nearest_valid_;
+};
+
+typedef boost::shared_ptr<const RemapTable> RemapTablePtr;
+
+/*
+ * Thread safe cache of remap tables keyed by the sonar geometry (bearings,
+ * beam width, bin count and beam count). At most capacity tables are kept,
+ * the least recently used one is dropped first.
+ */
+class RemapTableCache {
+public:
+
+    explicit RemapTableCache(size_t capacity = 8)
+        : capacity_(capacity)
+    {
+    }
+
+    virtual ~RemapTableCache() {
+    }
+
+    RemapTablePtr table(const base::samples::Sonar& sample);
+
+    void clear();
+
+    size_t size();
+
+    static RemapTableCache& shared();
+
+private:
+
+    struct Geometry {
+        bool operator<(const Geometry& other) const;
+
+        unsigned int bin_count;
+        unsigned int beam_count;
+        double beam_width;
+        std::vector<double> bearings;
+    };
+
+    typedef std::list<const Geometry*> GeometryList;
+    typedef std::map<Geometry, std::pair<RemapTablePtr, GeometryList::iterator> > TableMap;
+
+    static RemapTablePtr build(const base::samples::Sonar& sample);
+
+    // keys of the tables, most recently used first
+    GeometryList order_;
+    TableMap tables_;
+    size_t capacity_;
+    boost::mutex mutex_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_RemapTable_hpp */
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cmath>
+#include "SampleTreeModel.hpp"
+
+namespace sonarlog_annotation {
+
+SampleTreeModel::SampleTreeModel(const SonarSampleStore* sample_store, AnnotationStore* annotations, QObject* parent)
+    : QAbstractItemModel(parent)
+    , sample_store_(sample_store)
+    , annotations_(annotations)
+    , sample_count_(0)
+    , number_of_digits_(1)
+{
+}
+
+SampleTreeModel::~SampleTreeModel() {
+}
+
+QModelIndex SampleTreeModel::index(int row, int column, const QModelIndex& parent) const {
+    if (row < 0 || column < 0 || column >= 2 || row >= rowCount(parent)) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        return createNodeIndex(row, column, kSampleNode);
+    }
+
+    switch (kindOf(parent)) {
+        case kSampleNode:
+            return createNodeIndex(row, column, kSampleChildNode, parent.row());
+        case kSampleChildNode:
+            return createNodeIndex(row, column, kAnnotationNode, parentSampleOf(parent));
+        case kAnnotationNode:
+            return createNodeIndex(row, column, kPointNode, parentSampleOf(parent), parent.row());
+        default:
+            return QModelIndex();
+    }
+}
+
+QModelIndex SampleTreeModel::parent(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+
+    switch (kindOf(index)) {
+        case kSampleChildNode:
+            return createNodeIndex(parentSampleOf(index), 0, kSampleNode);
+        case kAnnotationNode:
+            return createNodeIndex(kAnnotationsRow, 0, kSampleChildNode, parentSampleOf(index));
+        case kPointNode:
+            return createNodeIndex(parentAnnotationOf(index), 0, kAnnotationNode, parentSampleOf(index));
+        default:
+            return QModelIndex();
+    }
+}
+
+int SampleTreeModel::rowCount(const QModelIndex& parent) const {
+    if (!parent.isValid()) {
+        return sample_count_;
+    }
+
+    if (parent.column() != 0) {
+        return 0;
+    }
+
+    switch (kindOf(parent)) {
+        case kSampleNode:
+            return kSampleChildCount + (annotations_->isEmpty(parent.row()) ? 0 : 1);
+        case kSampleChildNode:
+            return (parent.row() == kAnnotationsRow) ? annotations_->polygonCount(parentSampleOf(parent)) : 0;
+        case kAnnotationNode:
+            return annotations_->polygon(parentSampleOf(parent), parent.row()).size;
+        default:
+            return 0;
+    }
+}
+
+int SampleTreeModel::columnCount(const QModelIndex& parent) const {
+    return 2;
+}
+
+QVariant SampleTreeModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (role == Qt::UserRole) {
+        if (kindOf(index) == kAnnotationNode) {
+            return annotationData(parentSampleOf(index), index.row(), index.column(), role);
+        }
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (kindOf(index)) {
+        case kSampleNode:
+            return sampleData(index.row(), index.column());
+        case kSampleChildNode:
+            return sampleChildData(parentSampleOf(index), index.row(), index.column());
+        case kAnnotationNode:
+            return annotationData(parentSampleOf(index), index.row(), index.column(), role);
+        case kPointNode:
+            return pointData(parentSampleOf(index), parentAnnotationOf(index), index.row(), index.column());
+        default:
+            return QVariant();
+    }
+}
+
+QVariant SampleTreeModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        return (section == 0) ? QString("Name") : QString("Value");
+    }
+    return QVariant();
+}
+
+void SampleTreeModel::reset(int sample_count) {
+    beginResetModel();
+    sample_count_ = sample_count;
+    updateNumberOfDigits(sample_count);
+    endResetModel();
+}
+
+void SampleTreeModel::appendSamples(int sample_count) {
+    if (sample_count <= sample_count_) {
+        return;
+    }
+
+    updateNumberOfDigits(sample_count);
+    beginInsertRows(QModelIndex(), sample_count_, sample_count - 1);
+    sample_count_ = sample_count;
+    endInsertRows();
+}
+
+QModelIndex SampleTreeModel::sampleIndex(int sample) const {
+    if (sample < 0 || sample >= sample_count_) {
+        return QModelIndex();
+    }
+    return createNodeIndex(sample, 0, kSampleNode);
+}
+
+int SampleTreeModel::sampleOf(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return -1;
+    }
+    return (kindOf(index) == kSampleNode) ? index.row() : parentSampleOf(index);
+}
+
+QString SampleTreeModel::annotationName(const QModelIndex& index) const {
+    if (!index.isValid() || kindOf(index) != kAnnotationNode) {
+        return QString();
+    }
+    return QString::fromStdString(annotations_->polygonLabel(parentSampleOf(index), index.row()));
+}
+
+void SampleTreeModel::insertAnnotation(int sample, const QString& name, const std::vector<cv::Point2f>& points) {
+    std::string label = name.toStdString();
+
+    if (annotations_->contains(sample, label)) {
+        updateAnnotation(sample, name, points);
+        return;
+    }
+
+    if (sample >= sample_count_) {
+        annotations_->set(sample, label, points);
+        return;
+    }
+
+    if (annotations_->isEmpty(sample)) {
+        beginInsertRows(sampleIndex(sample), kAnnotationsRow, kAnnotationsRow);
+        annotations_->set(sample, label, points);
+        endInsertRows();
+        return;
+    }
+
+    // position the new label takes among the sorted polygons
+    int row = annotations_->polygonPosition(sample, label);
+    beginInsertRows(annotationsIndex(sample), row, row);
+    annotations_->set(sample, label, points);
+    endInsertRows();
+}
+
+void SampleTreeModel::updateAnnotation(int sample, const QString& name, const std::vector<cv::Point2f>& points) {
+    std::string label = name.toStdString();
+    int row = annotations_->findPolygon(sample, label);
+
+    if (row == -1) {
+        return;
+    }
+
+    if (sample >= sample_count_) {
+        annotations_->set(sample, label, points);
+        return;
+    }
+
+    QModelIndex parent = annotationIndex(sample, row);
+    AnnotationStore::PolygonView previous_points = annotations_->polygon(sample, row);
+    int previous_count = previous_points.size;
+    int count = points.size();
+
+    // only the vertices that moved need their rows refreshed
+    int first_changed = 0;
+    int last_changed = qMin(previous_count, count) - 1;
+    while (first_changed <= last_changed && previous_points.points[first_changed] == points[first_changed]) first_changed++;
+    while (last_changed >= first_changed && previous_points.points[last_changed] == points[last_changed]) last_changed--;
+
+    if (count > previous_count) {
+        beginInsertRows(parent, previous_count, count - 1);
+        annotations_->set(sample, label, points);
+        endInsertRows();
+    }
+    else if (count < previous_count) {
+        beginRemoveRows(parent, count, previous_count - 1);
+        annotations_->set(sample, label, points);
+        endRemoveRows();
+    }
+    else {
+        annotations_->set(sample, label, points);
+    }
+
+    if (first_changed > last_changed && count == previous_count) {
+        return;
+    }
+
+    emit dataChanged(createNodeIndex(row, 1, kAnnotationNode, sample),
+                     createNodeIndex(row, 1, kAnnotationNode, sample));
+
+    if (first_changed <= last_changed) {
+        emit dataChanged(createNodeIndex(first_changed, 1, kPointNode, sample, row),
+                         createNodeIndex(last_changed, 1, kPointNode, sample, row));
+    }
+}
+
+void SampleTreeModel::removeAnnotation(int sample, const QString& name) {
+    std::string label = name.toStdString();
+    int row = annotations_->findPolygon(sample, label);
+
+    if (row == -1) {
+        return;
+    }
+
+    if (sample >= sample_count_) {
+        annotations_->remove(sample, label);
+        return;
+    }
+
+    if (annotations_->polygonCount(sample) == 1) {
+        beginRemoveRows(sampleIndex(sample), kAnnotationsRow, kAnnotationsRow);
+        annotations_->remove(sample, label);
+        endRemoveRows();
+        return;
+    }
+
+    beginRemoveRows(annotationsIndex(sample), row, row);
+    annotations_->remove(sample, label);
+    endRemoveRows();
+}
+
+QModelIndex SampleTreeModel::annotationsIndex(int sample) const {
+    return createNodeIndex(kAnnotationsRow, 0, kSampleChildNode, sample);
+}
+
+QModelIndex SampleTreeModel::annotationIndex(int sample, int annotation) const {
+    return createNodeIndex(annotation, 0, kAnnotationNode, sample);
+}
+
+QVariant SampleTreeModel::sampleData(int sample, int column) const {
+    if (column == 0) {
+        return QString("Sample#%1").arg(sample + 1, number_of_digits_, 10, QChar('0'));
+    }
+
+    const SonarSampleIndexEntry& entry = sample_store_->entry(sample);
+    return QString::fromStdString(base::Time::fromMicroseconds(entry.time).toString());
+}
+
+QVariant SampleTreeModel::sampleChildData(int sample, int row, int column) const {
+    const SonarSampleIndexEntry& entry = sample_store_->entry(sample);
+
+    switch (row) {
+        case kBinCountRow:
+            return (column == 0) ? QString("BinCount") : QString("%1").arg(entry.bin_count);
+        case kBeamCountRow:
+            return (column == 0) ? QString("BeamCount") : QString("%1").arg(entry.beam_count);
+        case kImageWidthRow: {
+            int image_width = cos(entry.beam_width - M_PI_2) * entry.bin_count * 2.0;
+            return (column == 0) ? QString("ImageWidth") : QString("%1").arg(image_width);
+        }
+        case kAnnotationsRow:
+            return (column == 0) ? QString("Annotations") : QString("");
+        default:
+            return QVariant();
+    }
+}
+
+QVariant SampleTreeModel::annotationData(int sample, int annotation, int column, int role) const {
+    QString label = QString::fromStdString(annotations_->polygonLabel(sample, annotation));
+
+    if (role == Qt::UserRole) {
+        return (column == 0) ? QVariant(label) : QVariant(sample);
+    }
+
+    if (column == 0) {
+        return label;
+    }
+
+    AnnotationStore::PolygonView points = annotations_->polygon(sample, annotation);
+    QString point_string_list;
+    for (size_t i = 0; i < points.size; i++) {
+        point_string_list += pointString(points.points[i]);
+        if (i < points.size-1) {
+            point_string_list += ", ";
+        }
+    }
+    return point_string_list;
+}
+
+QVariant SampleTreeModel::pointData(int sample, int annotation, int point, int column) const {
+    if (column == 0) {
+        return QString("%1").arg(point);
+    }
+    return pointString(annotations_->polygon(sample, annotation).points[point]);
+}
+
+QString SampleTreeModel::pointString(const cv::Point2f& point) {
+    return QString("(%1,%2)").arg(point.x).arg(point.y);
+}
+
+void SampleTreeModel::updateNumberOfDigits(int sample_count) {
+    // size the sample names on the whole stream so that they don't change while it is indexed
+    int num = std::max(sample_count, (int)sample_store_->totalSamples());
+    number_of_digits_ = 1;
+    while (num /= 10) number_of_digits_++;
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,135 @@
+#ifndef sonarlog_annotation_SampleTreeModel_hpp
+#define sonarlog_annotation_SampleTreeModel_hpp
+
+#include <QtGui>
+#include <boost/static_assert.hpp>
+#include "AnnotationStore.hpp"
+#include "SonarSampleStore.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Item model over the sample index and the annotations of each sample.
+ *
+ * No item is allocated: the rows are produced on demand from the sample
+ * store and the annotation store. Each index carries the kind of node and
+ * the sample/annotation it belongs to, so parent() and sampleIndex() run
+ * in constant time whatever the length of the log.
+ *
+ * Every sample has the BinCount, BeamCount and ImageWidth rows and an
+ * Annotations row once it holds annotations. The annotations must be
+ * changed through the model so that the attached views are notified.
+ */
+class SampleTreeModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+
+    SampleTreeModel(const SonarSampleStore* sample_store, AnnotationStore* annotations, QObject* parent = 0);
+
+    virtual ~SampleTreeModel();
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
+
+    QModelIndex parent(const QModelIndex& index) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    // expose the first sample_count samples of the store
+    void reset(int sample_count);
+
+    // grow the top level rows up to sample_count samples
+    void appendSamples(int sample_count);
+
+    int sampleCount() const {
+        return sample_count_;
+    }
+
+    // top level index of the sample
+    QModelIndex sampleIndex(int sample) const;
+
+    // sample the index belongs to, -1 for an invalid index
+    int sampleOf(const QModelIndex& index) const;
+
+    // annotation name of an annotation row, empty for the other rows
+    QString annotationName(const QModelIndex& index) const;
+
+    void insertAnnotation(int sample, const QString& name, const std::vector<cv::Point2f>& points);
+
+    // only the rows of the vertices that moved are reported as changed
+    void updateAnnotation(int sample, const QString& name, const std::vector<cv::Point2f>& points);
+
+    void removeAnnotation(int sample, const QString& name);
+
+private:
+
+    enum NodeKind {
+        kSampleNode = 0,
+        kSampleChildNode,
+        kAnnotationNode,
+        kPointNode
+    };
+
+    enum SampleChildRow {
+        kBinCountRow = 0,
+        kBeamCountRow,
+        kImageWidthRow,
+        kAnnotationsRow
+    };
+
+    static const int kSampleChildCount = kAnnotationsRow;
+
+    // an index stores the kind of node and the sample/annotation of its parent,
+    // its own position is given by the row: 2 bits of kind, 32 bits of sample
+    // and 30 bits of annotation, which needs a 64-bit internal pointer
+    BOOST_STATIC_ASSERT(sizeof(void*) >= sizeof(quint64));
+
+    static quint64 packId(NodeKind kind, int sample = 0, int annotation = 0) {
+        return (((quint64)annotation & 0x3FFFFFFF) << 34) |
+               (((quint64)sample & 0xFFFFFFFF) << 2) |
+               (quint64)kind;
+    }
+
+    static NodeKind kindOf(const QModelIndex& index) {
+        return (NodeKind)((quint64)index.internalId() & 0x3);
+    }
+
+    static int parentSampleOf(const QModelIndex& index) {
+        return (int)(((quint64)index.internalId() >> 2) & 0xFFFFFFFF);
+    }
+
+    static int parentAnnotationOf(const QModelIndex& index) {
+        return (int)(((quint64)index.internalId() >> 34) & 0x3FFFFFFF);
+    }
+
+    QModelIndex createNodeIndex(int row, int column, NodeKind kind, int sample = 0, int annotation = 0) const {
+        return createIndex(row, column, (void*)(quintptr)packId(kind, sample, annotation));
+    }
+
+    QModelIndex annotationsIndex(int sample) const;
+    QModelIndex annotationIndex(int sample, int annotation) const;
+
+    QVariant sampleData(int sample, int column) const;
+    QVariant sampleChildData(int sample, int row, int column) const;
+    QVariant annotationData(int sample, int annotation, int column, int role) const;
+    QVariant pointData(int sample, int annotation, int point, int column) const;
+
+    static QString pointString(const cv::Point2f& point);
+
+    void updateNumberOfDigits(int sample_count);
+
+    const SonarSampleStore* sample_store_;
+    AnnotationStore* annotations_;
+    int sample_count_;
+    int number_of_digits_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_SampleTreeModel_hpp */
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <boost/bind/bind.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include "SonarDataLoader.hpp"
+#include "SonarLogIndexFile.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+class RandomIndex {
+public:
+    RandomIndex(unsigned int seed)
+        : generator_(seed)
+    {
+    }
+
+    ptrdiff_t operator()(ptrdiff_t n) {
+        return boost::random::uniform_int_distribution<ptrdiff_t>(0, n - 1)(generator_);
+    }
+
+private:
+    boost::random::mt19937 generator_;
+};
+
+} /* namespace */
+
+SonarDataLoader::SonarDataLoader(const std::string& logfilepath,
+                                 const std::string& stream_name,
+                                 const std::string& annotation_filepath,
+                                 const SonarDataLoaderOptions& options)
+    : options_(options)
+    , logfilepath_(logfilepath)
+    , stream_name_(stream_name)
+    , index_filepath_(SonarLogIndexFile::defaultFilePath(logfilepath, stream_name))
+    , sample_store_(0)
+    , epoch_(0)
+    , ready_batches_(std::max<size_t>(options.prefetch_batches, 1))
+    , next_batch_(0)
+    , active_workers_(0)
+    , stop_(false)
+{
+    options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+
+    if (options_.thread_count == 0) {
+        options_.thread_count = std::max(1u, boost::thread::hardware_concurrency());
+    }
+
+    // nothing is produced until start()
+    ready_batches_.close();
+
+    annotations_ = AnnotationFileReader(annotation_filepath).read();
+    sample_store_.open(logfilepath_, stream_name_, index_filepath_);
+
+    for (size_t i = 0; i < annotations_.size(); i++) {
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations_[i].begin(); it != annotations_[i].end(); it++) {
+            label_values_.insert(std::make_pair(it->first, 0));
+        }
+    }
+
+    if (label_values_.size() > AnnotationRasterizer::kMaxLabels) {
+        std::stringstream ss;
+        ss << "too many labels for 8-bit masks: " << label_values_.size()
+           << " (at most " << AnnotationRasterizer::kMaxLabels << ")";
+        throw std::runtime_error(ss.str());
+    }
+
+    uchar label_value = 1;
+    AnnotationRasterizer::LabelValues::iterator label_it;
+    for (label_it = label_values_.begin(); label_it != label_values_.end(); label_it++) {
+        label_it->second = label_value++;
+    }
+
+    for (size_t sample_index = 0; sample_index < sample_store_.size(); sample_index++) {
+        bool annotated = sample_index < annotations_.size() && !annotations_[sample_index].empty();
+        if (annotated || !options_.annotated_only) {
+            samples_.push_back(sample_index);
+        }
+    }
+}
+
+SonarDataLoader::~SonarDataLoader() {
+    stop();
+}
+
+size_t SonarDataLoader::batchCount() const {
+    if (options_.drop_last) {
+        return samples_.size() / options_.batch_size;
+    }
+    return (samples_.size() + options_.batch_size - 1) / options_.batch_size;
+}
+
+void SonarDataLoader::start() {
+    stop();
+
+    order_ = samples_;
+    if (options_.shuffle) {
+        RandomIndex random_index(options_.seed + epoch_);
+        std::random_shuffle(order_.begin(), order_.end(), random_index);
+    }
+
+    epoch_++;
+    next_batch_ = 0;
+    stop_ = false;
+    active_workers_ = options_.thread_count;
+    failed_samples_.clear();
+    error_.clear();
+    ready_batches_.reset();
+
+    for (size_t i = 0; i < options_.thread_count; i++) {
+        threads_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&SonarDataLoader::worker, this))));
+    }
+}
+
+bool SonarDataLoader::next(SonarBatchPtr& batch) {
+    if (ready_batches_.pop(batch)) {
+        return true;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!error_.empty()) {
+        throw std::runtime_error(error_);
+    }
+
+    return false;
+}
+
+std::vector<SonarSampleError> SonarDataLoader::failedSamples() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return failed_samples_;
+}
+
+void SonarDataLoader::recycle(const SonarBatchPtr& batch) {
+    if (batch) {
+        boost::mutex::scoped_lock lock(mutex_);
+        free_batches_.push_back(batch);
+    }
+}
+
+void SonarDataLoader::stop() {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        stop_ = true;
+    }
+
+    ready_batches_.close();
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        threads_[i]->join();
+    }
+    threads_.clear();
+
+    // keep the buffers of the batches that were not consumed
+    SonarBatchPtr batch;
+    while (ready_batches_.pop(batch)) {
+        recycle(batch);
+    }
+}
+
+void SonarDataLoader::worker() {
+    try {
+        // the samples are decoded through a stream of the worker, opened
+        // with the index the loader built so the log is not scanned again
+        SonarSampleStore sample_store(0);
+        sample_store.open(logfilepath_, stream_name_, sample_store_.index());
+
+        FrameRenderer frame_renderer;
+        AnnotationRasterizer rasterizer;
+
+        while (true) {
+            size_t batch_index;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (stop_ || next_batch_ >= batchCount()) {
+                    break;
+                }
+                batch_index = next_batch_++;
+            }
+
+            SonarBatchPtr batch = freeBatch();
+            fillBatch(batch_index, *batch, sample_store, frame_renderer, rasterizer);
+
+            // every sample of the batch failed
+            if (batch->size == 0) {
+                recycle(batch);
+                continue;
+            }
+
+            if (!ready_batches_.push(batch)) {
+                recycle(batch);
+                break;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        fail(e.what());
+    }
+    catch (...) {
+        fail("unknown error");
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if (--active_workers_ == 0) {
+        ready_batches_.close();
+    }
+}
+
+void SonarDataLoader::fillBatch(size_t batch_index,
+                                SonarBatch& batch,
+                                SonarSampleStore& sample_store,
+                                FrameRenderer& frame_renderer,
+                                AnnotationRasterizer& rasterizer)
+{
+    size_t begin = batch_index * options_.batch_size;
+    size_t end = std::min(begin + options_.batch_size, order_.size());
+
+    batch.size = 0;
+    batch.sample_indices.resize(options_.batch_size);
+    batch.images.resize(options_.batch_size);
+    batch.masks.resize(options_.batch_size);
+    batch.annotations.resize(options_.batch_size);
+
+    for (size_t position = begin; position < end; position++) {
+        size_t sample_index = order_[position];
+
+        // a failed sample is left out, the next one takes its slot
+        try {
+            SonarSamplePtr sample = sample_store.sample(sample_index);
+            if (!sample || !hasCompleteBins(*sample)) {
+                throw std::runtime_error("the sample has no complete beam x bin data");
+            }
+
+            fillSample(batch.size, batch, sample_index, *sample, frame_renderer, rasterizer);
+            batch.size++;
+        }
+        catch (const std::exception& e) {
+            addFailedSample(sample_index, e.what());
+        }
+    }
+}
+
+void SonarDataLoader::fillSample(size_t i,
+                                 SonarBatch& batch,
+                                 size_t sample_index,
+                                 const base::samples::Sonar& sample,
+                                 FrameRenderer& frame_renderer,
+                                 AnnotationRasterizer& rasterizer)
+{
+    batch.sample_indices[i] = sample_index;
+    batch.annotations[i] = (sample_index < annotations_.size()) ? annotations_[sample_index] : AnnotationFileReader::AnnotationMap();
+
+    frame_renderer.reset(sample);
+    const RemapTablePtr& remap_table = frame_renderer.remap_table();
+
+    if (options_.polar) {
+        cv::Mat polar_image(sample.beam_count, sample.bin_count, CV_32F, (void*)&sample.bins[0]);
+        polar_image.convertTo(batch.images[i], CV_8U, 255.0);
+        rasterizer.rasterizePolar(batch.annotations[i],
+                                  label_values_,
+                                  remap_table->size(),
+                                  remap_table->cart_to_polar(),
+                                  sample.beam_count,
+                                  sample.bin_count,
+                                  batch.masks[i]);
+    }
+    else {
+        frame_renderer.render(options_.mode, batch.images[i]);
+        rasterizer.rasterizeCartesian(batch.annotations[i], label_values_, remap_table->size(), batch.masks[i]);
+    }
+}
+
+void SonarDataLoader::addFailedSample(size_t sample_index, const std::string& error) {
+    boost::mutex::scoped_lock lock(mutex_);
+    SonarSampleError failed_sample;
+    failed_sample.sample_index = sample_index;
+    failed_sample.error = error;
+    failed_samples_.push_back(failed_sample);
+}
+
+void SonarDataLoader::fail(const std::string& error) {
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (error_.empty()) {
+            error_ = error;
+        }
+        stop_ = true;
+    }
+
+    // wake the consumer and the workers waiting on a full queue
+    ready_batches_.close();
+}
+
+SonarBatchPtr SonarDataLoader::freeBatch() {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (free_batches_.empty()) {
+        return SonarBatchPtr(new SonarBatch());
+    }
+
+    SonarBatchPtr batch = free_batches_.back();
+    free_batches_.pop_back();
+    return batch;
+}
+
+} /* namespace sonarlog_annotation */
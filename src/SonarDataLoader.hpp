@@ -0,0 +1,183 @@
+#ifndef sonarlog_annotation_SonarDataLoader_hpp
+#define sonarlog_annotation_SonarDataLoader_hpp
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "AnnotationFileReader.hpp"
+#include "AnnotationRasterizer.hpp"
+#include "BoundedQueue.hpp"
+#include "FrameRenderer.hpp"
+#include "SonarSampleStore.hpp"
+
+namespace sonarlog_annotation {
+
+struct SonarDataLoaderOptions {
+    SonarDataLoaderOptions()
+        : batch_size(8)
+        , shuffle(true)
+        , seed(0)
+        , thread_count(0)
+        , prefetch_batches(4)
+        , mode(kDisplayRaw)
+        , polar(false)
+        , annotated_only(true)
+        , drop_last(false)
+    {
+    }
+
+    size_t batch_size;
+    bool shuffle;
+    unsigned int seed;
+
+    // worker threads decoding and rendering the batches, 0 uses one per core
+    size_t thread_count;
+
+    // batches rendered ahead of the consumer
+    size_t prefetch_batches;
+
+    DisplayMode mode;
+
+    // polar (beam x bin) images and masks instead of cartesian ones
+    bool polar;
+
+    bool annotated_only;
+    bool drop_last;
+};
+
+struct SonarBatch {
+    SonarBatch()
+        : size(0)
+    {
+    }
+
+    size_t size;
+    std::vector<size_t> sample_indices;
+    std::vector<cv::Mat> images;
+    std::vector<cv::Mat> masks;
+    std::vector<AnnotationFileReader::AnnotationMap> annotations;
+};
+
+typedef boost::shared_ptr<SonarBatch> SonarBatchPtr;
+
+struct SonarSampleError {
+    size_t sample_index;
+    std::string error;
+};
+
+/*
+ * Iterates batches of (sonar frame, label mask, annotations) straight from
+ * a sonar log and its annotation file.
+ *
+ * Each epoch visits the selected samples in (optionally shuffled) order.
+ * The batches are rendered by a pool of worker threads into a bounded
+ * queue. Each worker reads the log through its own stream, opened with the
+ * index of the loader, so decoding, rendering and rasterization all run in
+ * parallel. Batches handed back through recycle() are reused, so that
+ * their image buffers are not allocated again.
+ *
+ * A sample that cannot be decoded or rendered is left out of its batch
+ * and listed by failedSamples(). Any other worker error ends the epoch and
+ * is thrown by next().
+ *
+ *   SonarDataLoader loader(log, stream, annotation_file, options);
+ *   loader.start();
+ *   SonarBatchPtr batch;
+ *   while (loader.next(batch)) {
+ *       ...
+ *       loader.recycle(batch);
+ *   }
+ */
+class SonarDataLoader {
+public:
+
+    SonarDataLoader(const std::string& logfilepath,
+                    const std::string& stream_name,
+                    const std::string& annotation_filepath,
+                    const SonarDataLoaderOptions& options = SonarDataLoaderOptions());
+
+    virtual ~SonarDataLoader();
+
+    // the label values written in the masks, by default the labels in sorted order from 1
+    void setLabelValues(const AnnotationRasterizer::LabelValues& label_values) {
+        label_values_ = label_values;
+    }
+
+    const AnnotationRasterizer::LabelValues& labelValues() const {
+        return label_values_;
+    }
+
+    // start a new epoch, an epoch in progress is stopped
+    void start();
+
+    // blocks until the next batch is ready, returns false at the end of the
+    // epoch and when no epoch is running, throws std::runtime_error when a
+    // worker failed
+    bool next(SonarBatchPtr& batch);
+
+    // give a consumed batch back for reuse
+    void recycle(const SonarBatchPtr& batch);
+
+    void stop();
+
+    size_t sampleCount() const {
+        return samples_.size();
+    }
+
+    size_t batchCount() const;
+
+    size_t epoch() const {
+        return epoch_;
+    }
+
+    // samples left out of the batches of the current epoch
+    std::vector<SonarSampleError> failedSamples();
+
+private:
+
+    void worker();
+    void fillBatch(size_t batch_index,
+                   SonarBatch& batch,
+                   SonarSampleStore& sample_store,
+                   FrameRenderer& frame_renderer,
+                   AnnotationRasterizer& rasterizer);
+    void fillSample(size_t i,
+                    SonarBatch& batch,
+                    size_t sample_index,
+                    const base::samples::Sonar& sample,
+                    FrameRenderer& frame_renderer,
+                    AnnotationRasterizer& rasterizer);
+    void addFailedSample(size_t sample_index, const std::string& error);
+    void fail(const std::string& error);
+    SonarBatchPtr freeBatch();
+
+    SonarDataLoaderOptions options_;
+    std::string logfilepath_;
+    std::string stream_name_;
+    std::string index_filepath_;
+    SonarSampleStore sample_store_;
+    std::vector<AnnotationFileReader::AnnotationMap> annotations_;
+    AnnotationRasterizer::LabelValues label_values_;
+
+    std::vector<size_t> samples_;
+    std::vector<size_t> order_;
+    size_t epoch_;
+
+    BoundedQueue<SonarBatchPtr> ready_batches_;
+    std::vector<SonarBatchPtr> free_batches_;
+
+    std::vector<boost::shared_ptr<boost::thread> > threads_;
+    boost::mutex mutex_;
+    size_t next_batch_;
+    size_t active_workers_;
+    bool stop_;
+
+    std::vector<SonarSampleError> failed_samples_;
+    std::string error_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_SonarDataLoader_hpp */
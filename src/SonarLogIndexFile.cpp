@@ -0,0 +1,137 @@
+#include <cstring>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "SonarLogIndexFile.hpp"
+
+namespace sonarlog_annotation {
+
+namespace {
+
+const char kIndexFileMagic[4] = { 'S', 'L', 'I', 'X' };
+const uint32_t kIndexFileVersion = 1;
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+} /* namespace */
+
+bool SonarLogIndexFile::read(const std::string& logfilepath,
+                             const std::string& stream_name,
+                             std::vector<SonarSampleIndexEntry>& index)
+{
+    uint64_t log_size;
+    int64_t log_mtime;
+    if (!logFileStatus(logfilepath, log_size, log_mtime)) {
+        return false;
+    }
+
+    std::ifstream in(filepath_.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (!in.good() || memcmp(magic, kIndexFileMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    uint32_t version;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t name_length;
+    if (!readValue(in, version) || version != kIndexFileVersion ||
+        !readValue(in, size) || size != log_size ||
+        !readValue(in, mtime) || mtime != log_mtime ||
+        !readValue(in, name_length) || name_length != stream_name.size()) {
+        return false;
+    }
+
+    std::string name(name_length, '\0');
+    in.read(&name[0], name_length);
+    if (!in.good() || name != stream_name) {
+        return false;
+    }
+
+    uint64_t count;
+    if (!readValue(in, count) || count > log_size) {
+        return false;
+    }
+
+    std::vector<SonarSampleIndexEntry> entries(count);
+    for (uint64_t i = 0; i < count; i++) {
+        SonarSampleIndexEntry& entry = entries[i];
+        if (!readValue(in, entry.position) ||
+            !readValue(in, entry.time) ||
+            !readValue(in, entry.bin_count) ||
+            !readValue(in, entry.beam_count) ||
+            !readValue(in, entry.beam_width)) {
+            return false;
+        }
+    }
+
+    index.swap(entries);
+    return true;
+}
+
+bool SonarLogIndexFile::write(const std::string& logfilepath,
+                              const std::string& stream_name,
+                              const std::vector<SonarSampleIndexEntry>& index)
+{
+    uint64_t log_size;
+    int64_t log_mtime;
+    if (!logFileStatus(logfilepath, log_size, log_mtime)) {
+        return false;
+    }
+
+    std::ofstream out(filepath_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out.write(kIndexFileMagic, sizeof(kIndexFileMagic));
+    writeValue(out, kIndexFileVersion);
+    writeValue(out, log_size);
+    writeValue(out, log_mtime);
+    writeValue(out, static_cast<uint32_t>(stream_name.size()));
+    out.write(stream_name.data(), stream_name.size());
+    writeValue(out, static_cast<uint64_t>(index.size()));
+
+    for (size_t i = 0; i < index.size(); i++) {
+        writeValue(out, index[i].position);
+        writeValue(out, index[i].time);
+        writeValue(out, index[i].bin_count);
+        writeValue(out, index[i].beam_count);
+        writeValue(out, index[i].beam_width);
+    }
+
+    out.close();
+    return !out.fail();
+}
+
+std::string SonarLogIndexFile::defaultFilePath(const std::string& logfilepath, const std::string& stream_name) {
+    boost::filesystem::path path(logfilepath);
+    return (path.parent_path() / path.stem()).string() + "_" + stream_name + ".idx";
+}
+
+bool SonarLogIndexFile::logFileStatus(const std::string& logfilepath, uint64_t& size, int64_t& mtime) {
+    boost::system::error_code error;
+
+    size = boost::filesystem::file_size(logfilepath, error);
+    if (error) {
+        return false;
+    }
+
+    mtime = boost::filesystem::last_write_time(logfilepath, error);
+    return !error;
+}
+
+} /* namespace sonarlog_annotation */
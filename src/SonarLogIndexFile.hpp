@@ -0,0 +1,51 @@
+#ifndef sonarlog_annotation_SonarLogIndexFile_hpp
+#define sonarlog_annotation_SonarLogIndexFile_hpp
+
+#include <string>
+#include <vector>
+#include "SonarSampleStore.hpp"
+
+namespace sonarlog_annotation {
+
+/*
+ * Sidecar file holding the sample index of a sonar log stream.
+ *
+ * The file records the size and modification time of the log it was built
+ * from, an index file that does not match the current log is rejected.
+ */
+class SonarLogIndexFile {
+public:
+
+    SonarLogIndexFile(const std::string& filepath)
+        : filepath_(filepath)
+    {
+    }
+
+    virtual ~SonarLogIndexFile() {
+    }
+
+    bool read(const std::string& logfilepath,
+              const std::string& stream_name,
+              std::vector<SonarSampleIndexEntry>& index);
+
+    bool write(const std::string& logfilepath,
+               const std::string& stream_name,
+               const std::vector<SonarSampleIndexEntry>& index);
+
+    const std::string& filepath() const {
+        return filepath_;
+    }
+
+    // <log directory>/<log name>_<stream name>.idx
+    static std::string defaultFilePath(const std::string& logfilepath, const std::string& stream_name);
+
+private:
+
+    bool logFileStatus(const std::string& logfilepath, uint64_t& size, int64_t& mtime);
+
+    std::string filepath_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_SonarLogIndexFile_hpp */
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <limits>
+#include "Profiler.hpp"
+#include "SonarLogIndexFile.hpp"
+#include "SonarSampleStore.hpp"
+
+namespace sonarlog_annotation {
+
+// rebuilt samples kept for the resident frames asked most recently
+static const size_t kRehydratedSamples = 4;
+
+SonarSampleStore::SonarSampleStore(size_t resident_capacity, BinEncoding bin_encoding)
+    : indexed_count_(0)
+    , total_samples_(0)
+    , next_position_(0)
+    , resident_capacity_(resident_capacity)
+    , resident_bytes_(0)
+    , bin_encoding_(bin_encoding)
+{
+}
+
+SonarSampleStore::~SonarSampleStore() {
+    close();
+}
+
+void SonarSampleStore::open(const std::string& logfilepath,
+                            const std::string& stream_name,
+                            const std::string& index_filepath)
+{
+    beginOpen(logfilepath, stream_name, index_filepath);
+    while (indexBatch(total_samples_) > 0);
+}
+
+void SonarSampleStore::beginOpen(const std::string& logfilepath,
+                                 const std::string& stream_name,
+                                 const std::string& index_filepath)
+{
+    close();
+
+    ScopedTimer timer("samples.open");
+    boost::mutex::scoped_lock lock(mutex_);
+    openStream(logfilepath, stream_name);
+    index_filepath_ = index_filepath;
+
+    if (!index_filepath.empty()) {
+        SonarLogIndexFile index_file(index_filepath);
+        if (index_file.read(logfilepath, stream_name, index_) &&
+            index_.size() == total_samples_) {
+            publishIndex();
+            return;
+        }
+    }
+
+    beginScan();
+}
+
+void SonarSampleStore::open(const std::string& logfilepath,
+                            const std::string& stream_name,
+                            const std::vector<SonarSampleIndexEntry>& index)
+{
+    close();
+
+    {
+        ScopedTimer timer("samples.open");
+        boost::mutex::scoped_lock lock(mutex_);
+        openStream(logfilepath, stream_name);
+        index_filepath_.clear();
+
+        if (index.size() == total_samples_) {
+            index_ = index;
+            publishIndex();
+            return;
+        }
+
+        // the index does not belong to this stream
+        beginScan();
+    }
+
+    while (indexBatch(total_samples_) > 0);
+}
+
+void SonarSampleStore::openStream(const std::string& logfilepath, const std::string& stream_name) {
+    reader_.reset(new rock_util::LogReader(logfilepath));
+    stream_.reset(new rock_util::LogStream(reader_->stream(stream_name)));
+    total_samples_ = stream_->total_samples();
+    logfilepath_ = logfilepath;
+    stream_name_ = stream_name;
+}
+
+void SonarSampleStore::beginScan() {
+    // the entries must keep their address while the index grows
+    index_.clear();
+    index_.reserve(total_samples_);
+    stream_->reset();
+    next_position_ = stream_->current_sample_index();
+}
+
+size_t SonarSampleStore::indexBatch(size_t batch_size) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!stream_ || index_.size() >= total_samples_) {
+        return 0;
+    }
+
+    ScopedTimer timer("samples.index_batch");
+
+    size_t count = 0;
+    stream_->set_current_sample_index(next_position_);
+    while (count < batch_size && index_.size() < total_samples_) {
+        SonarSampleIndexEntry entry;
+        entry.position = stream_->current_sample_index();
+
+        base::samples::Sonar sample;
+        stream_->next<base::samples::Sonar>(sample);
+
+        entry.time = sample.time.toMicroseconds();
+        entry.bin_count = sample.bin_count;
+        entry.beam_count = sample.beam_count;
+        entry.beam_width = sample.beam_width.getRad();
+        index_.push_back(entry);
+        count++;
+    }
+    next_position_ = stream_->current_sample_index();
+
+    publishIndex();
+
+    if (index_.size() == total_samples_ && !index_filepath_.empty()) {
+        SonarLogIndexFile index_file(index_filepath_);
+        index_file.write(logfilepath_, stream_name_, index_);
+    }
+
+    return count;
+}
+
+void SonarSampleStore::close() {
+    boost::mutex::scoped_lock lock(mutex_);
+    resident_order_.clear();
+    resident_samples_.clear();
+    rehydrated_order_.clear();
+    resident_bytes_ = 0;
+    geometries_.clear();
+    index_.clear();
+    publishIndex();
+    total_samples_ = 0;
+    next_position_ = 0;
+    stream_.reset();
+    reader_.reset();
+}
+
+SonarSamplePtr SonarSampleStore::sample(size_t index) {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!stream_ || index >= indexed_count_) {
+        return SonarSamplePtr();
+    }
+
+    ResidentMap::iterator it = resident_samples_.find(index);
+    if (it != resident_samples_.end()) {
+        resident_order_.splice(resident_order_.begin(), resident_order_, it->second.position);
+
+        SonarSamplePtr sample = it->second.sample;
+        if (!sample) {
+            boost::shared_ptr<base::samples::Sonar> rehydrated(new base::samples::Sonar());
+            it->second.frame->rehydrate(*rehydrated);
+            sample = rehydrated;
+        }
+
+        keepRehydrated(it, sample);
+        return sample;
+    }
+
+    ScopedTimer timer("samples.decode");
+    boost::shared_ptr<base::samples::Sonar> decoded(new base::samples::Sonar());
+    stream_->set_current_sample_index(index_[index].position);
+    stream_->next<base::samples::Sonar>(*decoded);
+
+    CompactSonarFramePtr frame(new CompactSonarFrame(*decoded, geometries_.geometry(*decoded), bin_encoding_));
+
+    // the sample is handed out as a hit would rebuild it, a float frame
+    // keeps the decoded bins as they are
+    SonarSamplePtr sample = decoded;
+    if (bin_encoding_ != kBinEncodingFloat) {
+        frame->decodeBins(decoded->bins);
+    }
+
+    resident_order_.push_front(index);
+    ResidentFrame resident;
+    resident.frame = frame;
+    resident.position = resident_order_.begin();
+    it = resident_samples_.insert(std::make_pair(index, resident)).first;
+    resident_bytes_ += frame->byteSize();
+
+    keepRehydrated(it, sample);
+    evict();
+    return sample;
+}
+
+void SonarSampleStore::setResidentCapacity(size_t resident_capacity) {
+    boost::mutex::scoped_lock lock(mutex_);
+    resident_capacity_ = resident_capacity;
+    evict();
+}
+
+int SonarSampleStore::findSample(int64_t time, TimeSeek seek) const {
+    boost::mutex::scoped_lock lock(index_mutex_);
+
+    if (time_index_.empty()) {
+        return -1;
+    }
+
+    typedef std::vector<std::pair<int64_t, size_t> >::const_iterator TimeIterator;
+
+    if (seek == kSeekAtOrBefore) {
+        TimeIterator it = std::upper_bound(time_index_.begin(), time_index_.end(),
+                                           std::make_pair(time, std::numeric_limits<size_t>::max()));
+        return (it == time_index_.begin()) ? -1 : (int)(it - 1)->second;
+    }
+
+    TimeIterator it = std::lower_bound(time_index_.begin(), time_index_.end(), std::make_pair(time, (size_t)0));
+
+    if (seek == kSeekAtOrAfter) {
+        return (it == time_index_.end()) ? -1 : (int)it->second;
+    }
+
+    if (it == time_index_.end()) {
+        return (it - 1)->second;
+    }
+
+    if (it == time_index_.begin()) {
+        return it->second;
+    }
+
+    return (time - (it - 1)->first <= it->first - time) ? (it - 1)->second : it->second;
+}
+
+bool SonarSampleStore::timeRange(int64_t& first_time, int64_t& last_time) const {
+    boost::mutex::scoped_lock lock(index_mutex_);
+
+    if (time_index_.empty()) {
+        return false;
+    }
+
+    first_time = time_index_.front().first;
+    last_time = time_index_.back().first;
+    return true;
+}
+
+void SonarSampleStore::publishIndex() {
+    boost::mutex::scoped_lock lock(index_mutex_);
+    indexed_count_ = index_.size();
+
+    // the index was cleared or replaced since it was last published
+    if (indexed_count_ < time_index_.size()) {
+        time_index_.clear();
+    }
+
+    size_t sorted_count = time_index_.size();
+    time_index_.reserve(indexed_count_);
+    for (size_t i = sorted_count; i < indexed_count_; i++) {
+        time_index_.push_back(std::make_pair(index_[i].time, i));
+    }
+
+    // the samples of a log are almost always in time order, a batch that
+    // goes back in time is sorted and merged into the sorted prefix
+    bool ordered = true;
+    for (size_t i = std::max<size_t>(sorted_count, 1); i < time_index_.size() && ordered; i++) {
+        ordered = !(time_index_[i] < time_index_[i - 1]);
+    }
+
+    if (!ordered) {
+        std::sort(time_index_.begin() + sorted_count, time_index_.end());
+        std::inplace_merge(time_index_.begin(), time_index_.begin() + sorted_count, time_index_.end());
+    }
+}
+
+void SonarSampleStore::setBinEncoding(BinEncoding bin_encoding) {
+    boost::mutex::scoped_lock lock(mutex_);
+    bin_encoding_ = bin_encoding;
+}
+
+size_t SonarSampleStore::residentBytes() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return resident_bytes_;
+}
+
+void SonarSampleStore::keepRehydrated(ResidentMap::iterator it, const SonarSamplePtr& sample) {
+    if (it->second.sample) {
+        rehydrated_order_.remove(it->first);
+    }
+    else {
+        it->second.sample = sample;
+        resident_bytes_ += sampleBytes(*sample);
+    }
+
+    rehydrated_order_.push_front(it->first);
+
+    while (rehydrated_order_.size() > kRehydratedSamples) {
+        dropRehydrated(resident_samples_.find(rehydrated_order_.back()));
+    }
+}
+
+void SonarSampleStore::dropRehydrated(ResidentMap::iterator it) {
+    if (it->second.sample) {
+        resident_bytes_ -= sampleBytes(*it->second.sample);
+        it->second.sample.reset();
+        rehydrated_order_.remove(it->first);
+    }
+}
+
+void SonarSampleStore::evict() {
+    while (resident_bytes_ > resident_capacity_ && !resident_order_.empty()) {
+        ResidentMap::iterator it = resident_samples_.find(resident_order_.back());
+        dropRehydrated(it);
+        resident_bytes_ -= it->second.frame->byteSize();
+        resident_samples_.erase(it);
+        resident_order_.pop_back();
+    }
+}
+
+size_t SonarSampleStore::sampleBytes(const base::samples::Sonar& sample) {
+    return sizeof(sample) +
+           sample.timestamps.capacity() * sizeof(base::Time) +
+           sample.bearings.capacity() * sizeof(base::Angle) +
+           sample.bins.capacity() * sizeof(float);
+}
+
+} /* namespace sonarlog_annotation */
@@ -0,0 +1,212 @@
+#ifndef sonarlog_annotation_SonarSampleStore_hpp
+#define sonarlog_annotation_SonarSampleStore_hpp
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <base/samples/Sonar.hpp>
+#include <rock_util/LogReader.hpp>
+#include "CompactSonarFrame.hpp"
+
+namespace sonarlog_annotation {
+
+struct SonarSampleIndexEntry {
+    SonarSampleIndexEntry()
+        : position(0)
+        , time(0)
+        , bin_count(0)
+        , beam_count(0)
+        , beam_width(0)
+    {
+    }
+
+    // position of the sample inside the pocolog stream
+    uint64_t position;
+
+    // sample time in microseconds
+    int64_t time;
+
+    uint32_t bin_count;
+    uint32_t beam_count;
+
+    // beam width in radians
+    double beam_width;
+};
+
+typedef boost::shared_ptr<const base::samples::Sonar> SonarSamplePtr;
+
+// whether the sample holds one bin per beam and bin, the bins of any other
+// sample cannot be read as a beam x bin image
+inline bool hasCompleteBins(const base::samples::Sonar& sample) {
+    return !sample.bins.empty() && sample.bins.size() == (size_t)sample.beam_count * sample.bin_count;
+}
+
+/*
+ * Gives indexed access to the sonar samples of a log stream.
+ *
+ * Opening the store scans the stream once and keeps only a lightweight
+ * index entry per sample. The sample itself is decoded on demand and
+ * the most recently used ones are kept resident, up to a number of bytes,
+ * as compact frames whose bins are encoded with the store bin encoding and
+ * whose geometry is shared. A sample is always handed out rebuilt from its
+ * compact frame, so it reads the same whether it was resident or decoded,
+ * and the last few rebuilt samples are kept to be handed out again.
+ *
+ * When an index file path is given, the index is loaded from that sidecar
+ * file and the stream is only scanned when the sidecar is missing or stale.
+ *
+ * The scan can also be driven in batches (beginOpen/indexBatch) so that the
+ * samples indexed so far are usable while the rest of the stream is read,
+ * size() only counts the samples already indexed.
+ *
+ * The indexed samples are also kept sorted by time, so a sample can be
+ * found from a timestamp without decoding any sample.
+ */
+class SonarSampleStore {
+public:
+
+    enum TimeSeek {
+        kSeekNearest = 0,
+        kSeekAtOrAfter,
+        kSeekAtOrBefore
+    };
+
+    // the resident capacity is in bytes
+    explicit SonarSampleStore(size_t resident_capacity = 16 * 1024 * 1024, BinEncoding bin_encoding = kBinEncodingFloat);
+
+    virtual ~SonarSampleStore();
+
+    void open(const std::string& logfilepath,
+              const std::string& stream_name,
+              const std::string& index_filepath = std::string());
+
+    // open the stream with the index built by another store of the same
+    // stream, the stream is only scanned when the index does not match it
+    void open(const std::string& logfilepath,
+              const std::string& stream_name,
+              const std::vector<SonarSampleIndexEntry>& index);
+
+    // open the stream and load the sidecar index, the stream is left to be
+    // scanned by indexBatch when the sidecar is missing or stale
+    void beginOpen(const std::string& logfilepath,
+                   const std::string& stream_name,
+                   const std::string& index_filepath = std::string());
+
+    // index up to batch_size more samples, returns the number indexed
+    size_t indexBatch(size_t batch_size);
+
+    void close();
+
+    size_t size() const {
+        boost::mutex::scoped_lock lock(index_mutex_);
+        return indexed_count_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // number of samples in the stream, indexed or not
+    size_t totalSamples() const {
+        return total_samples_;
+    }
+
+    bool indexComplete() const {
+        return size() == total_samples_;
+    }
+
+    // entries below size() are never moved while the stream is indexed
+    const SonarSampleIndexEntry& entry(size_t index) const {
+        return index_[index];
+    }
+
+    // the whole index once indexComplete() holds
+    const std::vector<SonarSampleIndexEntry>& index() const {
+        return index_;
+    }
+
+    // indexed sample found from the time in microseconds, -1 if there is none
+    int findSample(int64_t time, TimeSeek seek = kSeekNearest) const;
+
+    // times of the earliest and latest indexed samples, false while none is indexed
+    bool timeRange(int64_t& first_time, int64_t& last_time) const;
+
+    // decode the sample, it is safe to call from any thread
+    SonarSamplePtr sample(size_t index);
+
+    void setResidentCapacity(size_t resident_capacity);
+
+    size_t residentCapacity() const {
+        return resident_capacity_;
+    }
+
+    // resident frames already encoded keep their encoding
+    void setBinEncoding(BinEncoding bin_encoding);
+
+    BinEncoding binEncoding() const {
+        return bin_encoding_;
+    }
+
+    // bytes held by the resident frames and the rebuilt samples
+    size_t residentBytes();
+
+private:
+
+    typedef std::list<size_t> ResidentList;
+
+    struct ResidentFrame {
+        CompactSonarFramePtr frame;
+        SonarSamplePtr sample;
+        ResidentList::iterator position;
+    };
+
+    typedef std::map<size_t, ResidentFrame> ResidentMap;
+
+    void openStream(const std::string& logfilepath, const std::string& stream_name);
+    void beginScan();
+    void publishIndex();
+    void keepRehydrated(ResidentMap::iterator it, const SonarSamplePtr& sample);
+    void dropRehydrated(ResidentMap::iterator it);
+    void evict();
+
+    static size_t sampleBytes(const base::samples::Sonar& sample);
+
+    std::vector<SonarSampleIndexEntry> index_;
+    size_t indexed_count_;
+
+    // (time, sample) of the indexed samples sorted by time
+    std::vector<std::pair<int64_t, size_t> > time_index_;
+    size_t total_samples_;
+
+    // stream position of the next sample to index
+    uint64_t next_position_;
+
+    std::string logfilepath_;
+    std::string stream_name_;
+    std::string index_filepath_;
+
+    boost::scoped_ptr<rock_util::LogReader> reader_;
+    boost::scoped_ptr<rock_util::LogStream> stream_;
+
+    ResidentList resident_order_;
+    ResidentMap resident_samples_;
+
+    // resident samples whose rebuilt sample is kept, most recent first
+    ResidentList rehydrated_order_;
+    size_t resident_capacity_;
+    size_t resident_bytes_;
+    BinEncoding bin_encoding_;
+    SonarGeometryTable geometries_;
+
+    boost::mutex mutex_;
+    mutable boost::mutex index_mutex_;
+};
+
+} /* namespace sonarlog_annotation */
+
+#endif /* sonarlog_annotation_SonarSampleStore_hpp */
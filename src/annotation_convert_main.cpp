@@ -0,0 +1,31 @@
+#include <iostream>
+#include <string>
+#include "AnnotationBinaryFile.hpp"
+
+using namespace sonarlog_annotation;
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cout << "Usage: " << argv[0] << " <input annotation file> <output annotation file>" << std::endl;
+        std::cout << "Converts a YAML annotation file to the binary format and back." << std::endl;
+        return 1;
+    }
+
+    std::string input_filepath = argv[1];
+    std::string output_filepath = argv[2];
+
+    try {
+        if (annotation_binary_file::isBinaryFile(input_filepath)) {
+            annotation_binary_file::convertBinaryToYaml(input_filepath, output_filepath);
+        }
+        else {
+            annotation_binary_file::convertYamlToBinary(input_filepath, output_filepath);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include "AnnotationBinaryFile.hpp"
+#include "AnnotationFileReader.hpp"
+#include "AnnotationFileWriter.hpp"
+#include "AnnotationStore.hpp"
+#include "AnnotationWriter.hpp"
+#include "FrameRenderer.hpp"
+#include "RemapTable.hpp"
+
+using namespace sonarlog_annotation;
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+struct BenchmarkSettings {
+    size_t frames;
+    size_t beam_count;
+    size_t bin_count;
+    double beam_width;
+    size_t samples;
+    size_t annotated_samples;
+    size_t polygons;
+    size_t points;
+    size_t iterations;
+    size_t hit_tests;
+    unsigned int seed;
+};
+
+/*
+ * Latencies of one benchmark, each entry is one iteration processing
+ * items_per_iteration items.
+ */
+struct BenchmarkResult {
+    BenchmarkResult(const std::string& name, const std::string& unit, double items_per_iteration)
+        : name(name)
+        , unit(unit)
+        , items_per_iteration(items_per_iteration)
+    {
+    }
+
+    double percentile(double p) const {
+        std::vector<double> sorted(latencies);
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()));
+        return sorted[index];
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (size_t i = 0; i < latencies.size(); i++) sum += latencies[i];
+        return sum / latencies.size();
+    }
+
+    std::string name;
+    std::string unit;
+    double items_per_iteration;
+    std::vector<double> latencies;
+};
+
+class Stopwatch {
+public:
+    Stopwatch()
+        : start_ticks_(cv::getTickCount())
+    {
+    }
+
+    double elapsedMilliseconds() const {
+        return (cv::getTickCount() - start_ticks_) * 1000.0 / cv::getTickFrequency();
+    }
+
+private:
+    int64 start_ticks_;
+};
+
+base::samples::Sonar syntheticSonar(const BenchmarkSettings& settings, boost::random::mt19937& generator, size_t frame) {
+    boost::random::uniform_real_distribution<float> speckle(0.0f, 0.25f);
+
+    base::samples::Sonar sample;
+    sample.time = base::Time::fromMicroseconds(frame * 100000);
+    sample.bin_count = settings.bin_count;
+    sample.beam_count = settings.beam_count;
+    sample.beam_width = base::Angle::fromRad(settings.beam_width);
+    sample.beam_height = base::Angle::fromRad(20.0 * M_PI / 180.0);
+
+    sample.bearings.resize(settings.beam_count);
+    for (size_t beam = 0; beam < settings.beam_count; beam++) {
+        double step = (settings.beam_count > 1) ? settings.beam_width / (settings.beam_count - 1) : 0;
+        sample.bearings[beam] = base::Angle::fromRad(-settings.beam_width / 2 + beam * step);
+    }
+
+    // speckle with a bright arc that moves from frame to frame
+    sample.bins.resize(settings.beam_count * settings.bin_count);
+    size_t arc_bin = (frame * 7) % settings.bin_count;
+    for (size_t beam = 0; beam < settings.beam_count; beam++) {
+        for (size_t bin = 0; bin < settings.bin_count; bin++) {
+            float value = speckle(generator);
+            if (bin >= arc_bin && bin < arc_bin + settings.bin_count / 20) value += 0.6f;
+            sample.bins[beam * settings.bin_count + bin] = std::min(value, 1.0f);
+        }
+    }
+
+    return sample;
+}
+
+std::vector<AnnotationFileReader::AnnotationMap> syntheticAnnotations(const BenchmarkSettings& settings) {
+    std::vector<AnnotationFileReader::AnnotationMap> annotations(settings.samples);
+    size_t stride = std::max<size_t>(1, settings.samples / std::max<size_t>(1, settings.annotated_samples));
+
+    for (size_t sample = 0, annotated = 0; sample < settings.samples && annotated < settings.annotated_samples; sample += stride, annotated++) {
+        for (size_t polygon = 0; polygon < settings.polygons; polygon++) {
+            std::vector<cv::Point2f> points(settings.points);
+            for (size_t i = 0; i < settings.points; i++) {
+                double angle = 2.0 * M_PI * i / settings.points;
+                points[i] = cv::Point2f(200 + polygon * 30 + 20 * cos(angle), 300 + 20 * sin(angle));
+            }
+
+            std::stringstream name;
+            name << "label" << polygon;
+            annotations[sample][name.str()] = points;
+        }
+    }
+
+    return annotations;
+}
+
+void toSnapshot(const std::vector<AnnotationFileReader::AnnotationMap>& annotations, AnnotationWriter::Snapshot& snapshot) {
+    snapshot.resize(annotations.size());
+    for (size_t sample = 0; sample < annotations.size(); sample++) {
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations[sample].begin(); it != annotations[sample].end(); it++) {
+            snapshot.set(sample, it->first, it->second);
+        }
+    }
+}
+
+void benchmarkAnnotationFiles(const BenchmarkSettings& settings, const fs::path& work_directory, std::vector<BenchmarkResult>& results) {
+    std::vector<AnnotationFileReader::AnnotationMap> annotations = syntheticAnnotations(settings);
+    AnnotationWriter::Snapshot snapshot;
+    toSnapshot(annotations, snapshot);
+
+    std::string yaml_filepath = (work_directory / "benchmark_annotation.yml").string();
+    std::string snapshot_filepath = (work_directory / "benchmark_snapshot_annotation.yml").string();
+    std::string binary_filepath = (work_directory / "benchmark_annotation.slab").string();
+
+    BenchmarkResult write_yaml("annotation_write_yaml", "samples", settings.samples);
+    BenchmarkResult write_snapshot("annotation_write_snapshot", "samples", settings.samples);
+    BenchmarkResult write_binary("annotation_write_binary", "samples", settings.samples);
+    BenchmarkResult read_yaml("annotation_read_yaml", "samples", settings.samples);
+    BenchmarkResult read_yaml_store("annotation_read_yaml_store", "samples", settings.samples);
+    BenchmarkResult read_binary("annotation_read_binary", "samples", settings.samples);
+
+    for (size_t i = 0; i < settings.iterations; i++) {
+        {
+            Stopwatch stopwatch;
+            AnnotationFileWriter(yaml_filepath).write(annotations);
+            write_yaml.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            AnnotationWriter::writeAnnotationFile(QString::fromStdString(snapshot_filepath), snapshot);
+            write_snapshot.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            annotation_binary_file::write(binary_filepath, annotations);
+            write_binary.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            AnnotationFileReader(yaml_filepath).read();
+            read_yaml.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            AnnotationStore store;
+            AnnotationFileReader(yaml_filepath).read(store);
+            read_yaml_store.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            AnnotationFileReader(binary_filepath).read();
+            read_binary.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+    }
+
+    results.push_back(write_yaml);
+    results.push_back(write_snapshot);
+    results.push_back(write_binary);
+    results.push_back(read_yaml);
+    results.push_back(read_yaml_store);
+    results.push_back(read_binary);
+
+    fs::remove(yaml_filepath);
+    fs::remove(snapshot_filepath);
+    fs::remove(binary_filepath);
+}
+
+void benchmarkRendering(const BenchmarkSettings& settings, const std::vector<base::samples::Sonar>& frames, std::vector<BenchmarkResult>& results) {
+    // building the remap table is what SonarHolder::Reset costs for every new geometry
+    BenchmarkResult build("remap_table_build", "tables", 1);
+    for (size_t i = 0; i < settings.iterations; i++) {
+        RemapTableCache remap_table_cache;
+        Stopwatch stopwatch;
+        remap_table_cache.table(frames[0]);
+        build.latencies.push_back(stopwatch.elapsedMilliseconds());
+    }
+    results.push_back(build);
+
+    const char* names[] = { "render_raw", "render_enhanced", "render_preprocessed" };
+    const DisplayMode modes[] = { kDisplayRaw, kDisplayEnhanced, kDisplayPreprocessed };
+
+    for (size_t m = 0; m < 3; m++) {
+        RemapTableCache remap_table_cache;
+        FrameRenderer frame_renderer(remap_table_cache);
+        BenchmarkResult render(names[m], "frames", 1);
+        cv::Mat frame;
+
+        // warm up the remap table so the loop measures the per-frame path
+        frame_renderer.reset(frames[0]);
+
+        for (size_t i = 0; i < settings.iterations; i++) {
+            Stopwatch stopwatch;
+            frame_renderer.render(frames[i % frames.size()], modes[m], frame);
+            render.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+
+        results.push_back(render);
+    }
+}
+
+void benchmarkHitTesting(const BenchmarkSettings& settings, const std::vector<base::samples::Sonar>& frames, std::vector<BenchmarkResult>& results) {
+    RemapTableCache remap_table_cache;
+    RemapTablePtr remap_table = remap_table_cache.table(frames[0]);
+    const cv::Size& size = remap_table->size();
+
+    boost::random::mt19937 generator(settings.seed);
+    boost::random::uniform_real_distribution<float> x_distribution(-10.0f, size.width + 10.0f);
+    boost::random::uniform_real_distribution<float> y_distribution(-10.0f, size.height + 10.0f);
+
+    std::vector<cv::Point2f> points(settings.hit_tests);
+    for (size_t i = 0; i < points.size(); i++) {
+        points[i] = cv::Point2f(x_distribution(generator), y_distribution(generator));
+    }
+
+    BenchmarkResult hit_test("cart_to_polar_index", "points", points.size());
+    BenchmarkResult snap("snap_to_valid", "points", points.size());
+    size_t valid = 0;
+
+    for (size_t i = 0; i < settings.iterations; i++) {
+        {
+            Stopwatch stopwatch;
+            for (size_t p = 0; p < points.size(); p++) {
+                valid += (remap_table->cart_to_polar_index(points[p].x, points[p].y) != -1);
+            }
+            hit_test.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+        {
+            Stopwatch stopwatch;
+            for (size_t p = 0; p < points.size(); p++) {
+                float x = points[p].x;
+                float y = points[p].y;
+                valid += remap_table->snap_to_valid(x, y);
+            }
+            snap.latencies.push_back(stopwatch.elapsedMilliseconds());
+        }
+    }
+
+    // keep the loops from being optimized away
+    if (valid == 0) {
+        std::cerr << "no point hit the sonar fan" << std::endl;
+    }
+
+    results.push_back(hit_test);
+    results.push_back(snap);
+}
+
+void writeJson(std::ostream& out, const BenchmarkSettings& settings, const std::vector<BenchmarkResult>& results) {
+    out << std::fixed << std::setprecision(6);
+    out << "{\n";
+    out << "  \"settings\": {\n";
+    out << "    \"frames\": " << settings.frames << ",\n";
+    out << "    \"beam_count\": " << settings.beam_count << ",\n";
+    out << "    \"bin_count\": " << settings.bin_count << ",\n";
+    out << "    \"beam_width\": " << settings.beam_width << ",\n";
+    out << "    \"samples\": " << settings.samples << ",\n";
+    out << "    \"annotated_samples\": " << settings.annotated_samples << ",\n";
+    out << "    \"polygons\": " << settings.polygons << ",\n";
+    out << "    \"points\": " << settings.points << ",\n";
+    out << "    \"iterations\": " << settings.iterations << ",\n";
+    out << "    \"hit_tests\": " << settings.hit_tests << "\n";
+    out << "  },\n";
+    out << "  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        double mean = result.mean();
+
+        out << "    {\n";
+        out << "      \"name\": \"" << result.name << "\",\n";
+        out << "      \"iterations\": " << result.latencies.size() << ",\n";
+        out << "      \"mean_ms\": " << mean << ",\n";
+        out << "      \"p50_ms\": " << result.percentile(50) << ",\n";
+        out << "      \"p90_ms\": " << result.percentile(90) << ",\n";
+        out << "      \"p99_ms\": " << result.percentile(99) << ",\n";
+        out << "      \"max_ms\": " << result.percentile(100) << ",\n";
+        out << "      \"throughput\": " << ((mean > 0) ? result.items_per_iteration * 1000.0 / mean : 0.0) << ",\n";
+        out << "      \"throughput_unit\": \"" << result.unit << "/s\"\n";
+        out << "    }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+}
+
+int main(int argc, char **argv) {
+    BenchmarkSettings settings;
+    double beam_width_degrees;
+    std::string output_filepath;
+    std::string work_directory;
+
+    po::options_description description("Times the load, render, annotate and persist paths on synthetic data");
+    description.add_options()
+        ("help,h", "show this help")
+        ("frames", po::value<size_t>(&settings.frames)->default_value(16), "synthetic sonar frames to render")
+        ("beams", po::value<size_t>(&settings.beam_count)->default_value(256), "beams per frame")
+        ("bins", po::value<size_t>(&settings.bin_count)->default_value(512), "bins per beam")
+        ("beam-width", po::value<double>(&beam_width_degrees)->default_value(130.0), "beam width in degrees")
+        ("samples", po::value<size_t>(&settings.samples)->default_value(2000), "samples in the synthetic annotation file")
+        ("annotated-samples", po::value<size_t>(&settings.annotated_samples)->default_value(500), "samples holding annotations")
+        ("polygons", po::value<size_t>(&settings.polygons)->default_value(3), "annotations per annotated sample")
+        ("points", po::value<size_t>(&settings.points)->default_value(32), "vertices per annotation")
+        ("iterations,i", po::value<size_t>(&settings.iterations)->default_value(20), "iterations of each benchmark")
+        ("hit-tests", po::value<size_t>(&settings.hit_tests)->default_value(100000), "points per hit-testing iteration")
+        ("seed", po::value<unsigned int>(&settings.seed)->default_value(0), "random seed of the synthetic data")
+        ("work-dir,w", po::value<std::string>(&work_directory), "directory of the temporary annotation files (default: system temp)")
+        ("output,o", po::value<std::string>(&output_filepath), "JSON report (default: standard output)");
+
+    po::variables_map variables;
+    try {
+        po::store(po::parse_command_line(argc, argv, description), variables);
+        if (variables.count("help")) {
+            std::cout << description << std::endl;
+            return 0;
+        }
+        po::notify(variables);
+    }
+    catch (const po::error& e) {
+        std::cerr << e.what() << std::endl << description << std::endl;
+        return 1;
+    }
+
+    if (settings.frames == 0 || settings.iterations == 0 || settings.beam_count == 0 || settings.bin_count == 0) {
+        std::cerr << "frames, iterations, beams and bins must be positive" << std::endl;
+        return 1;
+    }
+
+    settings.beam_width = beam_width_degrees * M_PI / 180.0;
+
+    fs::path work_path = (work_directory.empty()) ? fs::temp_directory_path() : fs::path(work_directory);
+
+    boost::random::mt19937 generator(settings.seed);
+    std::vector<base::samples::Sonar> frames;
+    for (size_t i = 0; i < settings.frames; i++) {
+        frames.push_back(syntheticSonar(settings, generator, i));
+    }
+
+    std::vector<BenchmarkResult> results;
+
+    try {
+        benchmarkAnnotationFiles(settings, work_path, results);
+        benchmarkRendering(settings, frames, results);
+        benchmarkHitTesting(settings, frames, results);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (output_filepath.empty()) {
+        writeJson(std::cout, settings, results);
+    }
+    else {
+        std::ofstream out(output_filepath.c_str());
+        writeJson(out, settings, results);
+    }
+
+    return 0;
+}
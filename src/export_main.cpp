@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "AnnotationFileReader.hpp"
+#include "AnnotationRasterizer.hpp"
+#include "BoundedQueue.hpp"
+#include "FrameRenderer.hpp"
+#include "SonarLogIndexFile.hpp"
+#include "SonarSampleStore.hpp"
+
+using namespace sonarlog_annotation;
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+struct ExportJob {
+    size_t sample_index;
+    SonarSamplePtr sample;
+    const AnnotationFileReader::AnnotationMap* annotations;
+};
+
+struct ExportSettings {
+    fs::path output_directory;
+    DisplayMode mode;
+    bool polar;
+    AnnotationRasterizer::LabelValues label_values;
+};
+
+// samples the workers failed to export
+struct ExportErrors {
+    boost::mutex mutex;
+    size_t count;
+
+    ExportErrors()
+        : count(0)
+    {
+    }
+
+    void add(size_t sample_index, const std::string& error) {
+        boost::mutex::scoped_lock lock(mutex);
+        std::cerr << "sample " << sample_index << ": " << error << std::endl;
+        count++;
+    }
+};
+
+std::string sampleFileName(size_t sample_index) {
+    std::stringstream ss;
+    ss << "sample_" << std::setw(6) << std::setfill('0') << sample_index << ".png";
+    return ss.str();
+}
+
+void exportSample(const ExportJob& job, const ExportSettings* settings,
+                  FrameRenderer& frame_renderer, AnnotationRasterizer& rasterizer) {
+    if (!job.sample || !hasCompleteBins(*job.sample)) {
+        throw std::runtime_error("the sample has no complete beam x bin data");
+    }
+
+    const base::samples::Sonar& sample = *job.sample;
+    frame_renderer.reset(sample);
+
+    const RemapTablePtr& remap_table = frame_renderer.remap_table();
+
+    cv::Mat image;
+    cv::Mat mask;
+
+    if (settings->polar) {
+        // polar domain: one row per beam, one column per bin
+        cv::Mat polar_image(sample.beam_count, sample.bin_count, CV_32F, (void*)&sample.bins[0]);
+        polar_image.convertTo(image, CV_8U, 255.0);
+
+        rasterizer.rasterizePolar(*job.annotations,
+                                  settings->label_values,
+                                  remap_table->size(),
+                                  remap_table->cart_to_polar(),
+                                  sample.beam_count,
+                                  sample.bin_count,
+                                  mask);
+    }
+    else {
+        frame_renderer.render(settings->mode, image);
+        rasterizer.rasterizeCartesian(*job.annotations, settings->label_values, remap_table->size(), mask);
+    }
+
+    std::string filename = sampleFileName(job.sample_index);
+    std::string image_filepath = (settings->output_directory / "images" / filename).string();
+    std::string mask_filepath = (settings->output_directory / "masks" / filename).string();
+
+    if (!cv::imwrite(image_filepath, image)) {
+        throw std::runtime_error("cannot write " + image_filepath);
+    }
+
+    if (!cv::imwrite(mask_filepath, mask)) {
+        throw std::runtime_error("cannot write " + mask_filepath);
+    }
+}
+
+void exportWorker(BoundedQueue<ExportJob>* queue, const ExportSettings* settings, ExportErrors* errors) {
+    FrameRenderer frame_renderer;
+    AnnotationRasterizer rasterizer;
+    ExportJob job;
+
+    while (queue->pop(job)) {
+        // a failed sample is reported and the worker keeps draining the queue
+        try {
+            exportSample(job, settings, frame_renderer, rasterizer);
+        }
+        catch (const std::exception& e) {
+            errors->add(job.sample_index, e.what());
+        }
+        catch (...) {
+            errors->add(job.sample_index, "unknown error");
+        }
+
+        // release the sample before waiting for the next job
+        job = ExportJob();
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string logfilepath;
+    std::string stream_name;
+    std::string annotation_filepath;
+    std::string output_directory;
+    std::string mode;
+    size_t thread_count;
+    size_t queue_size;
+
+    po::options_description description("Exports the annotated samples of a sonar log as image and mask pairs");
+    description.add_options()
+        ("help,h", "show this help")
+        ("log,l", po::value<std::string>(&logfilepath)->required(), "pocolog file")
+        ("stream,s", po::value<std::string>(&stream_name)->default_value("gemini.sonar_samples"), "sonar stream name")
+        ("annotation,a", po::value<std::string>(&annotation_filepath), "annotation file (default: <log>_annotation.yml)")
+        ("output,o", po::value<std::string>(&output_directory)->required(), "output directory")
+        ("mode,m", po::value<std::string>(&mode)->default_value("raw"), "display mode: raw, enhanced or preprocessed")
+        ("polar,p", "write polar domain (beam x bin) images and masks")
+        ("threads,t", po::value<size_t>(&thread_count)->default_value(0), "render threads (default: one per core)")
+        ("queue,q", po::value<size_t>(&queue_size)->default_value(0), "decoded samples kept in flight (default: twice the threads)");
+
+    po::variables_map variables;
+    try {
+        po::store(po::parse_command_line(argc, argv, description), variables);
+        if (variables.count("help")) {
+            std::cout << description << std::endl;
+            return 0;
+        }
+        po::notify(variables);
+    }
+    catch (const po::error& e) {
+        std::cerr << e.what() << std::endl << description << std::endl;
+        return 1;
+    }
+
+    ExportSettings settings;
+    settings.output_directory = output_directory;
+    settings.polar = variables.count("polar") > 0;
+
+    if (mode == "raw") settings.mode = kDisplayRaw;
+    else if (mode == "enhanced") settings.mode = kDisplayEnhanced;
+    else if (mode == "preprocessed") settings.mode = kDisplayPreprocessed;
+    else {
+        std::cerr << "invalid display mode: " << mode << std::endl;
+        return 1;
+    }
+
+    fs::path log_path(logfilepath);
+    std::string log_basename = (log_path.parent_path() / log_path.stem()).string();
+    if (annotation_filepath.empty()) {
+        annotation_filepath = log_basename + "_annotation.yml";
+    }
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, boost::thread::hardware_concurrency());
+    }
+
+    if (queue_size == 0) {
+        queue_size = thread_count * 2;
+    }
+
+    std::vector<AnnotationFileReader::AnnotationMap> annotations;
+    SonarSampleStore sample_store(0);
+
+    try {
+        if (!fs::is_regular_file(annotation_filepath)) {
+            throw std::runtime_error("annotation file not found: " + annotation_filepath);
+        }
+
+        AnnotationFileReader reader(annotation_filepath);
+        annotations = reader.read();
+        if (!reader.opened()) {
+            throw std::runtime_error("cannot read the annotation file: " + annotation_filepath);
+        }
+
+        sample_store.open(logfilepath, stream_name, SonarLogIndexFile::defaultFilePath(logfilepath, stream_name));
+        fs::create_directories(settings.output_directory / "images");
+        fs::create_directories(settings.output_directory / "masks");
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // label values in the masks, 0 is the background
+    for (size_t i = 0; i < annotations.size(); i++) {
+        AnnotationFileReader::AnnotationMap::const_iterator it;
+        for (it = annotations[i].begin(); it != annotations[i].end(); it++) {
+            settings.label_values.insert(std::make_pair(it->first, 0));
+        }
+    }
+
+    if (settings.label_values.size() > AnnotationRasterizer::kMaxLabels) {
+        std::cerr << "too many labels for 8-bit masks: " << settings.label_values.size()
+                  << " (at most " << AnnotationRasterizer::kMaxLabels << ")" << std::endl;
+        return 1;
+    }
+
+    std::ofstream labels_file((settings.output_directory / "labels.txt").string().c_str());
+    int label_value = 1;
+    AnnotationRasterizer::LabelValues::iterator label_it;
+    for (label_it = settings.label_values.begin(); label_it != settings.label_values.end(); label_it++) {
+        label_it->second = label_value++;
+        labels_file << (int)label_it->second << " " << label_it->first << std::endl;
+    }
+    labels_file.close();
+
+    if (!labels_file) {
+        std::cerr << "cannot write the label list to " << output_directory << std::endl;
+        return 1;
+    }
+
+    BoundedQueue<ExportJob> queue(queue_size);
+    ExportErrors errors;
+    boost::thread_group threads;
+    for (size_t i = 0; i < thread_count; i++) {
+        threads.create_thread(boost::bind(&exportWorker, &queue, &settings, &errors));
+    }
+
+    // the log is decoded sequentially while the samples are rendered in parallel
+    size_t total_samples = std::min(annotations.size(), sample_store.size());
+    size_t exported = 0;
+    for (size_t sample_index = 0; sample_index < total_samples; sample_index++) {
+        if (annotations[sample_index].empty()) {
+            continue;
+        }
+
+        ExportJob job;
+        job.sample_index = sample_index;
+        job.sample = sample_store.sample(sample_index);
+        job.annotations = &annotations[sample_index];
+        queue.push(job);
+        exported++;
+    }
+
+    queue.close();
+    threads.join_all();
+
+    if (errors.count) {
+        std::cerr << "Failed to export " << errors.count << " of " << exported << " annotated samples" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Exported " << exported << " annotated samples to " << output_directory << std::endl;
+    return 0;
+}
@@ -17,6 +17,19 @@ int main(int argc, char **argv) {
         annotation_window->setStreamName("gemini.sonar_samples");
     }
 
+    if (QCoreApplication::arguments().size() > 2) {
+        // frame cache capacity in megabytes, a bad value keeps the default
+        bool ok = false;
+        qulonglong capacity_mb = QCoreApplication::arguments().at(2).toULongLong(&ok);
+        if (ok) {
+            annotation_window->setFrameCacheCapacity(capacity_mb * 1024 * 1024);
+        }
+        else {
+            std::cerr << "invalid frame cache capacity: " << QCoreApplication::arguments().at(2).toStdString()
+                      << " (megabytes expected), the default is kept" << std::endl;
+        }
+    }
+
     annotation_window->setWindowTitle(QString(APP_NAME));
     annotation_window->show();
     return app.exec();